@@ -0,0 +1,42 @@
+// Generated by logicgen from res/ex1.larr. Do not edit.
+#pragma once
+
+#include <cstdint>
+
+namespace ex1_larr {
+
+constexpr unsigned int num_inputs = 3;
+constexpr unsigned int num_outputs = 3;
+constexpr const char* input_names[] = {"i0", "i1", "i2"};
+constexpr const char* output_names[] = {"o0", "o1", "o2"};
+
+// in[i] holds input i of 64 vectors, out[o] receives output o of the same vectors
+constexpr void evaluate_sliced(const std::uint64_t* in, std::uint64_t* out) {
+    const std::uint64_t i0 = in[0];
+    const std::uint64_t i1 = in[1];
+    const std::uint64_t i2 = in[2];
+    const std::uint64_t p0 = ~i0 & i2;
+    const std::uint64_t p1 = i0 & ~i1 & ~i2;
+    const std::uint64_t p2 = ~i0 & i1 & i2;
+    const std::uint64_t p3 = i0 & ~i1 & ~i2;
+    out[0] = p0;
+    out[1] = p1 | p3;
+    out[2] = p1 | p2;
+}
+
+// Bit i of `in` is input i, bit o of the result is output o
+constexpr std::uint64_t evaluate(std::uint64_t in) {
+    const std::uint64_t i0 = in >> 0;
+    const std::uint64_t i1 = in >> 1;
+    const std::uint64_t i2 = in >> 2;
+    const std::uint64_t p0 = ~i0 & i2;
+    const std::uint64_t p1 = i0 & ~i1 & ~i2;
+    const std::uint64_t p2 = ~i0 & i1 & i2;
+    const std::uint64_t p3 = i0 & ~i1 & ~i2;
+    return 0
+        | ((p0) & 1) << 0
+        | ((p1 | p3) & 1) << 1
+        | ((p1 | p2) & 1) << 2;
+}
+
+} // namespace ex1_larr
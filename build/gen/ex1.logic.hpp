@@ -0,0 +1,36 @@
+// Generated by logicgen from res/ex1.logic. Do not edit.
+#pragma once
+
+#include <cstdint>
+
+namespace ex1_logic {
+
+constexpr unsigned int num_inputs = 3;
+constexpr unsigned int num_outputs = 1;
+constexpr const char* input_names[] = {"A", "B", "C"};
+constexpr const char* output_names[] = {"x"};
+
+// in[i] holds input i of 64 vectors, out[o] receives output o of the same vectors
+constexpr void evaluate_sliced(const std::uint64_t* in, std::uint64_t* out) {
+    const std::uint64_t A = in[0];
+    const std::uint64_t B = in[1];
+    const std::uint64_t C = in[2];
+    const std::uint64_t p0 = A & B & ~C;
+    const std::uint64_t p1 = ~A & B & C;
+    const std::uint64_t p2 = ~A & ~B & C;
+    out[0] = p0 | p1 | p2;
+}
+
+// Bit i of `in` is input i, bit o of the result is output o
+constexpr std::uint64_t evaluate(std::uint64_t in) {
+    const std::uint64_t A = in >> 0;
+    const std::uint64_t B = in >> 1;
+    const std::uint64_t C = in >> 2;
+    const std::uint64_t p0 = A & B & ~C;
+    const std::uint64_t p1 = ~A & B & C;
+    const std::uint64_t p2 = ~A & ~B & C;
+    return 0
+        | ((p0 | p1 | p2) & 1) << 0;
+}
+
+} // namespace ex1_logic
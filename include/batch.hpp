@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+/*
+    Non-interactive batch mode. A manifest lists one job per line:
+
+        circuit <netlist>
+        sweep <netlist> <component> <from> <to> <steps>
+        logic <logic file>
+        plot <f0> <points> <cos,cos,...> <sin,sin,...>
+
+    circuit writes the analyseCircuit report, sweep a CSV of every node
+    voltage and source current while one component steps from `from` to
+    `to`, logic the truth table of every binding and plot the samples as
+    CSV. Blank lines and lines starting with '#' are skipped.
+
+    Jobs run concurrently on up to `workers` threads (0: one per hardware
+    thread), each writing its own file in `out_dir`; failed jobs leave none.
+    A JSON summary of all jobs goes to `summary`. Returns the number of
+    failed jobs, or -1 if the manifest could not be read.
+*/
+int run_batch(const char* manifest, unsigned int workers, const char* out_dir, FILE* summary);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+class Stopwatch {
+    std::chrono::steady_clock::time_point start;
+
+    public:
+    Stopwatch();
+    void reset();
+    // Seconds since construction or the last reset
+    double elapsed();
+};
+
+struct Stats {
+    double min;
+    double median;
+    double mean;
+    double stddev;
+};
+
+Stats summarize(std::vector<double> samples);
+
+/*
+    Raw value of the CPU timestamp counter on x86, otherwise nanoseconds from
+    steady_clock. Check has_cycle_counter() to know which unit applies.
+*/
+unsigned long long cycle_count();
+bool has_cycle_counter();
+
+// Peak resident set size of this process in kilobytes, 0 where unsupported
+long peak_rss_kb();
+
+// Writes `"name":{"min":..,"median":..,"mean":..,"stddev":..}` for a JSON object
+void print_stats_json(FILE* out, const char* name, Stats stats);
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <array>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <vector>
 #include "matrix.hpp"
 #include "vector.hpp"
 
+// Low rank edits applied to a cached factorization before it is rebuilt
+const unsigned int MAX_RANK_UPDATES = 32;
+
 enum CompType {
     resistor,
     voltage,
@@ -21,19 +25,107 @@ struct Component {
     CompType type;
 };
 
+struct Subcircuit;
+
+/* A use of a .subckt definition */
+struct Instance {
+    char name[20];
+    unsigned int def;                // index into the definitions of the netlist
+    std::vector<unsigned int> nodes; // one node per port of the definition
+};
+
+/* Node voltages and source currents of a solved circuit */
+struct CircuitSolution {
+    std::vector<double> voltage; // by node id, NAN on floating islands
+    std::vector<double> current; // by voltage source, in netlist order, NAN on floating islands
+    std::vector<char> floating;  // by node id
+    unsigned int islands;        // independent pieces the circuit split into
+    std::vector<std::vector<unsigned int>> floatingIslands; // node ids of each
+    std::vector<unsigned int> selfLoops; // components with both ends on one node
+    unsigned int reducedUnknowns;  // unknowns left after topology reduction, all islands
+};
+
 class Circuit {
     unsigned int nN;
     unsigned int nV;
     unsigned int nR;
     unsigned int nI;
     std::vector<Component> comp;
+    std::vector<Instance> inst;
+    // Every .subckt of the netlist with its macromodel, shared by copies of the circuit
+    std::vector<std::shared_ptr<const Subcircuit>> defs;
+    // Original netlist label of every node id. Ids are dense and id 0 is ground.
+    std::vector<unsigned int> labels;
+
+    void compactNodes();
+    void reorderNodes();
+
+    struct Island;
+    std::vector<Island> splitIslands(CircuitSolution& sol);
+
+    struct Reduction;
+    Reduction reduceTopology();
+
+    /*
+        Factorization of the whole system kept between edits. A resistor
+        edit changes A by dg u u^T with u = e[n1] - e[n2]; those updates are
+        collected here and applied with the Sherman-Morrison-Woodbury formula
+        instead of factoring again. Source values only change the right hand side.
+    */
+    struct Factored {
+        bool valid = false;
+        LUFactor lu;
+        std::vector<std::array<unsigned int, 2>> ends; // u of each update
+        std::vector<double> dg;                        // conductance change of each update
+        std::vector<Vector> W;                         // A^-1 u of each update
+    } factored;
+
+    void buildRhs(Vector& Z);
+    bool factorAll();
+    int findComponent(const char* name);
+    unsigned int nodeId(unsigned int label);
+    void conductanceChanged(unsigned int n1, unsigned int n2, double dg);
 
     public: 
     Circuit();
     Circuit(unsigned int nN, unsigned int nV, unsigned int nR, unsigned int nI);
 
+    // Exits with a message on a malformed netlist
     static Circuit createFromFile(const char* filename);
-    void analyseCircuit();
+    // Reports a malformed netlist through `success` and `error` instead
+    static Circuit createFromFile(const char* filename, bool& success, std::string& error);
+    void buildSystem(std::vector<MatrixEntry>& A, Vector& Z);
+    CircuitSolution solve();
+    // Solution after edits, reusing the last factorization where it can
+    CircuitSolution resolve();
+    void analyseCircuit(FILE* out = stdout);
+
+    /* Edits for what-if runs. Nodes are netlist labels; unknown names return false. */
+    bool setValue(const char* name, double value);
+    void addComponent(const char* name, unsigned int n1, unsigned int n2, double value);
+    bool removeComponent(const char* name);
+
+    Component component(unsigned int i);
+    unsigned int nodeCount();
+    unsigned int componentCount();
+    // Number of unknowns in the nodal system: node voltages then source currents
+    unsigned int systemSize();
+    unsigned int nodeLabel(unsigned int id);
+
+    /*
+        Voltages of the internal nodes of an instance, recovered from the
+        port voltages in `sol`; `nodes` receives their labels within the
+        definition. Nested instances are named with dots, as in "X1.X3".
+        Returns false if there is no such instance.
+    */
+    bool internalVoltages(const char* instance, const CircuitSolution& sol,
+        std::vector<unsigned int>& nodes, std::vector<double>& voltage);
 };
 
+/*
+    Reverse Cuthill-McKee ordering of the nodes joined by resistors and
+    voltage sources. Returns perm with perm[new id] = old id; ground stays 0.
+*/
+std::vector<unsigned int> reverseCuthillMcKee(const std::vector<Component>& comp, unsigned int nN);
+
 Vector solveLinearSystem(Matrix A, Vector b);
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+#include "plotter.hpp"
+
+/*
+    Complex DFT of one size, X[k] = sum x[j] e^(-2 pi i jk / n), on split
+    real and imaginary arrays. Sizes made of the factors 2, 3, 4 and 5 run
+    as Stockham stages with precomputed twiddles; any other size goes
+    through Bluestein's chirp transform on a power of two plan.
+*/
+class FftPlan {
+    size_t n;
+    std::vector<size_t> radices;
+    // Per stage, twiddle (r, t) at [(r - 1) * span + t] where span is the product of earlier radices
+    std::vector<std::vector<double>> tw_re, tw_im;
+
+    std::shared_ptr<const FftPlan> inner; // power of two plan, Bluestein only
+    std::vector<double> chirp_re, chirp_im;
+    std::vector<double> kernel_re, kernel_im;
+
+    void stockham(double* re, double* im) const;
+    void bluestein(double* re, double* im) const;
+
+    public:
+    explicit FftPlan(size_t n);
+    size_t size() const;
+    void forward(double* re, double* im) const;
+    // Unscaled, so forward then inverse multiplies by n
+    void inverse(double* re, double* im) const;
+};
+
+/* Spectrum of n real samples, bins 0..n/2, through a half size complex plan when n is even */
+class RealFftPlan {
+    size_t n;
+    std::shared_ptr<const FftPlan> half;
+    std::vector<double> tw_re, tw_im;
+
+    public:
+    explicit RealFftPlan(size_t n);
+    size_t size() const;
+    // `re` and `im` hold n/2 + 1 bins
+    void forward(const double* x, double* re, double* im) const;
+};
+
+// Plans are built once per size and shared between threads
+std::shared_ptr<const FftPlan> fft_plan(size_t n);
+std::shared_ptr<const RealFftPlan> real_fft_plan(size_t n);
+
+enum fft_window { window_rect, window_hann, window_hamming, window_blackman };
+
+// Parses "rect", "hann", "hamming" or "blackman"
+bool parse_window(const char* name, fft_window& window);
+
+/* Coefficients in the form FourierPlotter takes: f0 in degrees per unit of x */
+struct FourierSeries {
+    double f0;
+    std::vector<double> cos_coefs;
+    std::vector<double> sin_coefs;
+};
+
+/*
+    Fourier series of `samples` taken `dx` apart starting at x = `x0`,
+    assuming the block spans `periods` periods of the fundamental. A
+    fractional span is cut down to its leading whole periods. Harmonics
+    above the Nyquist bin are zero. The window's coherent gain is divided
+    out so amplitudes stay comparable between windows.
+*/
+FourierSeries fourier_coefficients(std::span<const double> samples, double dx, size_t harmonics,
+                                   double periods = 1.0, fft_window window = window_rect, double x0 = 0.0);
+
+FourierPlotter to_plotter(const FourierSeries& series);
+
+/*
+    Analysis of a long capture in overlapping windowed blocks. Samples can
+    arrive in pieces of any size; every `block` samples, starting every
+    `hop` samples, are analysed as by fourier_coefficients and passed to
+    `on_block` with the index of their first sample. The stream starts at
+    x = `x0`, so phases of every block are referred to x = 0.
+*/
+class BlockAnalyzer {
+    size_t block;
+    size_t hop;
+    size_t harmonics;
+    size_t periods;  // whole periods analysed per block
+    size_t used;     // samples of a block spanning them
+    double dx;
+    double x0;
+    std::vector<double> window;
+    double gain;
+    std::vector<double> pending;
+    size_t head;     // first unconsumed sample in `pending`
+    size_t skip;     // samples to drop before the next block when hop > block
+    size_t position; // stream index of pending[head]
+    size_t blocks;
+    std::function<void(size_t, const FourierSeries&)> on_block;
+
+    public:
+    BlockAnalyzer(size_t block, size_t hop, size_t harmonics, double periods, fft_window window, double dx,
+                  double x0, std::function<void(size_t, const FourierSeries&)> on_block);
+    void push(std::span<const double> samples);
+    size_t get_blocks();
+};
+
+/*
+    Reads a waveform, one sample per line, either "value" or "x,value"
+    (comma or space separated, as written by the CSV plot renderer). With x
+    columns the spacing is taken from the first and last x. Blank lines and
+    lines starting with '#' are skipped; a file without samples is an error.
+*/
+bool read_waveform(const char* filename, std::vector<double>& samples, double& dx, double& x0);
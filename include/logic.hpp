@@ -1,7 +1,6 @@
 #pragma once
 #include <vector>
 #include <span>
-#include <variant>
 #include <cstdint>
 #include <string_view>
 
@@ -19,11 +18,7 @@ class CharBitSet {
     std::uint32_t get_raw();
 };
 
-enum parse_state {
-    S0, S1, S2, S3, S4
-};
-
-enum node_type { op_or = 0, op_and, val };
+enum node_type : std::uint8_t { op_or = 0, op_and, val };
 
 struct Node {
     node_type type;
@@ -31,33 +26,67 @@ struct Node {
     bool inv;
 };
 
-enum parse_status { expect_binding, expect_equal, expect_var, unexpected_eof };
+enum parse_status { parse_ok, expect_binding, expect_equal, expect_var, unexpected_eof };
 
+/* A view of one equation's nodes, which live in the arena of a LogicFile */
 class Equation {
     char binding;
-    std::vector<Node> nodes;
+    std::span<const Node> nodes;
     CharBitSet vars;
 
     public:
     Equation();
-    Equation(char binding, std::vector<Node> nodes, CharBitSet vars);
+    Equation(char binding, std::span<const Node> nodes, CharBitSet vars);
     char get_binding();
     CharBitSet get_vars();
-    std::span<Node> get_nodes();
+    std::span<const Node> get_nodes();
     bool evaluate(std::span<bool, 26> map);
 };
 
-using ParseResult = std::variant<parse_status, Equation>;
+/*
+    Every equation of a file. All nodes sit back to back in one arena, so
+    loading a file allocates a handful of times however many equations it
+    holds. Copies point their equations at their own arena.
+*/
+class LogicFile {
+    std::vector<Node> arena;
+    std::vector<Equation> eqns;
+    size_t skipped = 0;
+
+    public:
+    LogicFile();
+    LogicFile(const LogicFile& other);
+    LogicFile(LogicFile&& other) = default;
+    LogicFile& operator=(const LogicFile& other);
+    LogicFile& operator=(LogicFile&& other) = default;
+
+    /*
+        Parses `text`, one equation per line:
 
-ParseResult parse(const char* str, size_t& cur, std::size_t len);
-void print_stack(std::span<Node> stack);
-std::vector<Equation> parse_file(const char* filename, bool& success);
+        ```ebnf
+        [a-z] <spaces> = <spaces> ([A-Z]'? <spaces>)+ (<plus> <spaces> ([A-Z]'? <spaces>)+)*
+        ```
+
+        For example, `x = A B' + CD + S'` is valid. Lines that fail to parse
+        are reported on stderr and skipped.
+    */
+    void parse(std::string_view text);
+
+    Equation* begin();
+    Equation* end();
+    Equation* data();
+    size_t size();
+    bool empty();
+    Equation& operator[](size_t i);
+    // Lines dropped by parse because they did not parse
+    size_t get_skipped();
+};
+
+LogicFile parse_file(const char* filename, bool& success);
+void print_stack(std::span<const Node> stack);
 
 /* Helper methods */
 CharBitSet combine_vars(std::span<Equation> eqns);
 int search_binding(std::span<Equation> eqns, char binding);
 
-ParseResult parse2(std::string_view& str);
-bool skip_while(std::string_view& str, char char_to_skip);
-
-void print_equation_pretty(Equation& eqn);
\ No newline at end of file
+void print_equation_pretty(Equation& eqn);
@@ -20,5 +20,12 @@ class LogicMap {
     LogicMap();
     static LogicMap create_from_file(const char* logicfile, bool& success);
     bool evaluate(std::span<bool> values, size_t output_idx);
+    size_t get_num_inputs();
+    size_t get_num_outputs();
+    size_t get_num_products();
+    // (inverted, regular) flag pairs for every input of every product
+    std::span<const uint8_t> get_and_nodes();
+    // One row of product flags per output
+    std::span<const uint8_t> get_or_nodes();
     void print_map();
 };
\ No newline at end of file
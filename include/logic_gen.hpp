@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+#include <span>
+#include <string>
+#include <logic.hpp>
+#include <logic_arr.hpp>
+
+/*
+    Compiles a design into a C++ header of straight-line, branch-free
+    evaluators inside namespace `name`:
+
+        num_inputs, num_outputs, input_names[], output_names[]
+        evaluate_sliced(const uint64_t* in, uint64_t* out)
+            in[i] holds input i of 64 vectors, out[o] receives output o
+        evaluate(uint64_t in) -> uint64_t
+            bit i of `in` is input i, bit o of the result is output o
+            (only when both counts are at most 64)
+
+    Both are constexpr. For .logic files the inputs are the referenced
+    variables in alphabetical order and the outputs the bindings in file
+    order; for .larr files they follow the map's rows and columns.
+*/
+void write_logic_header(std::span<Equation> eqns, const char* name, const char* source, FILE* out);
+void write_logic_map_header(LogicMap& map, const char* name, const char* source, FILE* out);
+
+// Namespace name for a design file, e.g. "res/ex1.logic" -> "ex1_logic"
+std::string logic_header_name(const char* path);
@@ -3,6 +3,8 @@
 #include <cassert>
 #include <valarray>
 #include <initializer_list>
+#include <vector>
+#include "vector.hpp"
 
 class Matrix {
     std::valarray<double> _data;
@@ -21,3 +23,47 @@ class Matrix {
     size_t col_size();
     size_t size();
 };
+
+// One (row, col, value) term of a sparse matrix. Repeated positions are summed.
+struct MatrixEntry {
+    size_t row;
+    size_t col;
+    double value;
+};
+
+/*
+    LU factors of a square matrix without pivoting, the same as the
+    elimination solveLinearSystem has always done.
+
+    Only the profile (envelope) of the matrix is stored: each row of L from
+    its first nonzero column up to the diagonal and each column of U from its
+    first nonzero row down to the diagonal. Fill-in never leaves the profile,
+    so a well ordered (small bandwidth) system costs O(n b^2) to factor and
+    O(n b) memory instead of O(n^3) and O(n^2).
+*/
+class LUFactor {
+    size_t n;
+    std::vector<size_t> first_col; // first stored column of each row of L
+    std::vector<size_t> first_row; // first stored row of each column of U
+    std::vector<size_t> row_start; // offset of each row in `lower`
+    std::vector<size_t> col_start; // offset of each column in `upper`
+    std::vector<double> lower;
+    std::vector<double> upper;
+    double flop_count;
+
+    void allocate();
+    void add(size_t r, size_t c, double value);
+    void factor();
+
+    public:
+    LUFactor();
+    explicit LUFactor(Matrix A);
+    LUFactor(size_t n, const std::vector<MatrixEntry>& entries);
+
+    Vector solve(Vector b);
+    size_t size();
+    // Floating point operations spent on the factorization
+    double flops();
+    // Number of values held for L and U together
+    size_t storedEntries();
+};
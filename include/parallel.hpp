@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Number of hardware threads available for batch work (at least 1)
+unsigned int worker_count();
+
+/*
+    Both helpers below run inline when called from inside another parallel
+    region, so work that is itself spread over threads (batch jobs, islands)
+    does not oversubscribe the machine.
+*/
+
+/*
+    Splits [0, n) into contiguous chunks of at least `min_chunk` items and
+    calls fn(begin, end) for each chunk on its own thread. The last chunk runs
+    on the calling thread. Small ranges are run inline without spawning.
+*/
+void parallel_for(size_t n, size_t min_chunk, const std::function<void(size_t, size_t)>& fn);
+
+/*
+    Calls fn(i) for every i in [0, n) on up to `workers` threads. Items are
+    handed out one at a time, so uneven work balances itself; put the
+    heaviest items first for the best finish time. workers == 0 means
+    worker_count().
+*/
+void parallel_for_each(size_t n, unsigned int workers, const std::function<void(size_t)>& fn);
@@ -5,8 +5,9 @@
 #include <csignal>
 #include <cmath>
 #include <tuple>
+#include <span>
 
-#define PI 3.1415926535897932384626433f
+#define PI 3.1415926535897932384626433
 
 // Source: https://stackoverflow.com/a/23657072
 #define RED   "\x1B[31m"
@@ -26,14 +27,35 @@ const int PLOT_WIDTH = 270;
 const int TICK_INTERVAL = 10;
 const int c1[3] = {255, 102, 0};
 const int c3[3] = {198, 120, 221};
+// Longest period (in integer samples) kept in the sample cache
+const size_t MAX_PERIOD_CACHE = 1 << 20;
+// Number of samples start_plotter synthesizes ahead at a time
+const size_t PLOT_BLOCK = 4096;
+// Width of the sample blocks the batch kernels work on
+const size_t SAMPLE_LANES = 8;
+
+struct RenderOptions;
 
 class FourierPlotter {
-    std::vector<double> coefs;
+    // Coefficients are kept as two parallel arrays so the batch kernels can
+    // stream a_k and b_k together for every harmonic k.
+    std::vector<double> cos_coefs;
+    std::vector<double> sin_coefs;
     size_t coef_count;
     size_t cos_head;
     size_t sin_head;
     double f0;
     double max_amplitude;
+
+    // One whole period of samples on the integer grid. Empty when the
+    // signal does not repeat within MAX_PERIOD_CACHE integer samples.
+    std::vector<double> period_cache;
+    bool cache_valid;
+
+    void build_period_cache();
+    void sum_lanes(const double* c1, const double* s1, double* out);
+    void sample_block(const double* xs, double* out, size_t n);
+    void synthesize_block(double x0, double dx, std::span<double> out);
     
     public:
     FourierPlotter(size_t coef_count, double base_frequency);
@@ -41,9 +63,13 @@ class FourierPlotter {
     void append_cos_coef(double val);
     void append_sin_coef(double val);
     double sample(double x);
+    void sample_many(std::span<const double> xs, std::span<double> out);
+    void synthesize(double x0, double dx, std::span<double> out);
+    void sample_range(long x0, std::span<double> out);
     double fourier_norm();
     std::tuple<double, double> find_min_max();
     void start_plotter(size_t num_points);
+    void start_plotter(size_t num_points, const RenderOptions& opts);
 };
 
 void plotval(float d, int width);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+
+/*
+    Built-in profiling. Mark hot code with
+
+        PROFILE_SCOPE("circuit.assemble");   // time until the end of the block
+        PROFILE_COUNT("plotter.samples", n); // add n to a counter
+
+    and run with CAJUN_PROFILE set to "summary" for a table on stderr at
+    exit, or "trace" / "trace:<file>" for Chrome trace JSON (chrome://tracing,
+    Perfetto), written to cajun_trace.json by default. Binaries may also call
+    profile_start() from a flag. While profiling is off a marked scope costs
+    one predictable branch.
+
+    Every thread records into its own buffer, guarded by a lock that only the
+    report contends for: at exit each buffer is copied out under its lock and
+    the copies are merged, so threads still running then are safe.
+*/
+
+// Trace events kept per thread; later ones are only counted in the summary
+const unsigned int MAX_TRACE_EVENTS = 1 << 20;
+
+// Read relaxed by every marked scope; set by profile_start and cleared by the exit report
+extern std::atomic<bool> profile_on;
+
+/* One PROFILE_SCOPE or PROFILE_COUNT call site */
+struct ProfileSite {
+    const char* name;
+    unsigned int id;
+    explicit ProfileSite(const char* name);
+};
+
+long long profile_now();
+void profile_record(const ProfileSite& site, long long start, long long end);
+void profile_add(const ProfileSite& site, long long n);
+
+/*
+    Start profiling with a mode of "summary", "trace" or "trace:<file>" and
+    report when the program exits. Returns false on an unknown mode.
+*/
+bool profile_start(const char* mode);
+
+class ProfileScope {
+    const ProfileSite* site;
+    long long start;
+
+    public:
+    explicit ProfileScope(const ProfileSite& s): site(profile_on.load(std::memory_order_relaxed) ? &s : nullptr), start(site ? profile_now() : 0) {}
+    ~ProfileScope() { if (site) profile_record(*site, start, profile_now()); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) \
+    static const ProfileSite PROFILE_CONCAT(profile_site_, __LINE__)(name); \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_site_, __LINE__))
+#define PROFILE_COUNT(name, n) do { \
+        static const ProfileSite profile_site(name); \
+        if (profile_on.load(std::memory_order_relaxed)) profile_add(profile_site, (n)); \
+    } while (0)
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "plotter.hpp"
+
+enum render_mode {
+    render_terminal, // coloured ANSI plot, one line per point
+    render_csv,      // "x,value" text lines, no escape codes
+    render_binary    // packed {int64 x; double value} records
+};
+
+struct RenderOptions {
+    render_mode mode;
+    FILE* out;
+    // Lines composed into the buffer before it is written out
+    size_t lines_per_frame;
+    // Upper bound on frames written per second. 0 means unlimited.
+    double max_fps;
+    // When a frame is ready before its slot, drop it instead of waiting.
+    // Only has an effect with max_fps set.
+    bool skip_frames;
+};
+
+// Terminal output to `out`, every frame written as soon as it is full. Pacing is opt-in via max_fps.
+RenderOptions default_render_options(FILE* out = stdout);
+
+/*
+    Composes plot output into a preallocated buffer and emits a whole frame
+    with a single write instead of several printf calls per point.
+*/
+class PlotRenderer {
+    RenderOptions opts;
+    std::string buffer;
+    size_t lines_in_frame;
+    std::chrono::steady_clock::time_point next_slot;
+    std::chrono::steady_clock::duration frame_interval;
+    size_t frames_written;
+    size_t frames_skipped;
+
+    void append_terminal_line(long x, float y);
+    void append_csv_line(long x, double value);
+    void append_binary_record(long x, double value);
+
+    public:
+    PlotRenderer(RenderOptions opts);
+    ~PlotRenderer();
+
+    // `value` is the raw sample, `y` the sample normalized to [0, 1]
+    void point(long x, double value, float y);
+    void flush_frame();
+    // Flushes what is left and resets the terminal colours
+    void finish();
+    size_t get_frames_written();
+    size_t get_frames_skipped();
+};
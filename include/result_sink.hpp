@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "circuit.hpp"
+
+enum sink_format {
+    sink_csv,   // header line, then "point,V(...),...,I(...)" rows
+    sink_binary // columnar blocks, see ResultSink
+};
+
+/* What goes in each row, worked out once per circuit */
+struct ResultLayout {
+    std::string point_name;             // first column, e.g. the swept component
+    std::vector<unsigned int> nodes;    // solution node ids in output order
+    std::vector<unsigned int> labels;   // netlist labels of those nodes
+    std::vector<std::string> currents;  // voltage source names
+};
+
+// Nodes in ascending label order, then every voltage source
+ResultLayout result_layout(Circuit& c, const char* point_name);
+
+struct SinkOptions {
+    sink_format format;
+    FILE* out;
+    // Format and write on a background thread while the caller keeps solving
+    bool async;
+    // Rows queued before write() waits for the writer to catch up
+    size_t max_pending;
+};
+
+// CSV or binary to `out` by the file extension (".csv" is CSV), written asynchronously
+SinkOptions default_sink_options(FILE* out, const char* path = "");
+
+/*
+    Streams solutions to a file, one row per solve or sweep point. write()
+    only copies the values out; formatting and I/O happen on the writer.
+
+    The binary format, in host byte order:
+        char magic[8] = "CAJRES1\n"
+        u32 nodes, u32 currents
+        u32 length + bytes of point_name
+        u32 labels[nodes]
+        u32 length + bytes of each current name
+    followed by one block per row, until the end of the file:
+        f64 point, f64 voltage[nodes], f64 current[currents]
+    Floating nodes, and currents missing from a solution, are NaN.
+*/
+class ResultSink {
+    SinkOptions opts;
+    ResultLayout layout;
+    std::string buffer;
+    bool write_failed; // set by whichever thread formats; read once the writer is joined
+
+    std::mutex lock;
+    std::condition_variable ready, space;
+    std::deque<std::vector<double>> pending;
+    std::vector<std::vector<double>> spare; // rows handed back by the writer
+    bool done;
+    std::thread writer;
+
+    void write_header();
+    void append_row(const std::vector<double>& row);
+    void flush_buffer();
+    void run_writer();
+
+    public:
+    ResultSink(SinkOptions opts, ResultLayout layout);
+    ~ResultSink();
+
+    void write(double point, const CircuitSolution& sol);
+    // Writes out every queued row and stops the writer. False if any write to `out` failed.
+    bool finish();
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// Designs kept by the server before the least recently used one is dropped
+const size_t DEFAULT_CACHE_ENTRIES = 64;
+
+/*
+    Simulation daemon on a Unix domain socket. Clients send one request per
+    line and get one JSON object per line back:
+
+        solve <netlist>                                  node voltages and source currents
+        sweep <netlist> <component> <from> <to> <steps>  one row per step
+        eval <file.logic> [A=1,B=0,...]                  every binding
+        eval <file.larr> <input bits>                    every output
+        stats                                            cache counters
+        shutdown                                         stop the server
+
+    Parsed circuits (with their solution and factorization), equations and
+    logic maps stay in an LRU cache keyed by path. An entry is reused while
+    the file's mtime and size are unchanged, or when its content hash still
+    matches after a touch; otherwise the file is parsed again.
+
+    POSIX only; elsewhere both calls report an error and return 1.
+*/
+int run_server(const char* socket_path, size_t cache_entries);
+
+// Sends one request to a running server and writes the reply to `out`. Returns 0 on an ok reply.
+int query_server(const char* socket_path, const std::string& request, FILE* out);
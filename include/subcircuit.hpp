@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "circuit.hpp"
+
+/*
+    A .subckt definition. Components and nested instances use the labels
+    of the definition; label 0 is the global ground.
+
+    Its internal unknowns (nodes that are not ports, and the currents of its
+    voltage sources) are eliminated once, leaving a macromodel over the
+    ports: the Schur complement G = App - Api Aii^-1 Aip and the injection
+    J = bp - Api Aii^-1 bi. An instance then adds a P x P block to the
+    system it sits in, however large the definition is. K = Aii^-1 Aip and
+    c = Aii^-1 bi are kept so internal values can be recovered on demand.
+*/
+struct Subcircuit {
+    char name[20];
+    std::vector<unsigned int> ports; // port labels, in order
+    std::vector<Component> comp;
+    std::vector<Instance> inst;      // nodes hold labels
+
+    bool built = false;
+    bool grounded = false;           // some component reaches the global ground
+    std::vector<unsigned int> internal; // labels of the internal nodes, in unknown order
+    unsigned int unknowns = 0;       // internal nodes plus voltage source currents
+    std::vector<double> G;           // P x P, row major
+    std::vector<double> J;           // P
+    std::vector<double> K;           // unknowns x P, row major
+    std::vector<double> c;           // unknowns
+
+    size_t portCount() const { return ports.size(); }
+    /* Internal unknowns from the port voltages: x_i = c - K x_p */
+    std::vector<double> recover(const std::vector<double>& portVoltage) const;
+};
+
+/*
+    Compute the macromodels of defs[d] and of every definition it uses.
+    Returns false with a message in `error` on recursive or singular
+    definitions, and on voltage sources that fix a port voltage.
+*/
+bool buildMacromodel(std::vector<std::shared_ptr<Subcircuit>>& defs, unsigned int d, std::string& error);
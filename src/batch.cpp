@@ -0,0 +1,252 @@
+#include "batch.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bench.hpp"
+#include "circuit.hpp"
+#include "logic.hpp"
+#include "parallel.hpp"
+#include "plotter.hpp"
+#include "profile.hpp"
+#include "renderer.hpp"
+#include "result_sink.hpp"
+
+enum job_type { job_circuit, job_sweep, job_logic, job_plot };
+
+static const char* job_names[] = {"circuit", "sweep", "logic", "plot"};
+static const size_t job_args[] = {1, 5, 1, 4};
+static const char* job_extensions[] = {"txt", "csv", "txt", "csv"};
+
+struct BatchJob {
+    job_type type;
+    std::vector<std::string> args;
+    unsigned int line;
+    double weight; // rough cost, heaviest jobs are started first
+    std::string output;
+    bool ok;
+    std::string message;
+    double seconds;
+};
+
+static bool read_manifest(const char* manifest, std::vector<BatchJob>& jobs) {
+    std::ifstream file(manifest);
+    if (!file.is_open()) { fprintf(stderr, "Could not open file: %s\n", manifest); return false; }
+
+    std::string text;
+    for (unsigned int line = 1; std::getline(file, text); line++) {
+        std::istringstream words(text);
+        std::string word;
+        std::vector<std::string> tokens;
+        while (words >> word) tokens.push_back(word);
+        if (tokens.empty() || tokens[0][0] == '#') continue;
+
+        auto type = std::find(std::begin(job_names), std::end(job_names), tokens[0]);
+        size_t t = type - std::begin(job_names);
+        if (type == std::end(job_names) || tokens.size() != job_args[t] + 1) {
+            fprintf(stderr, "Could not read line %u in file %s.\n", line, manifest);
+            return false;
+        }
+        BatchJob job = {};
+        job.type = (job_type)t;
+        job.args.assign(tokens.begin() + 1, tokens.end());
+        job.line = line;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+static bool read_number(const std::string& text, double& value) {
+    char* end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+static std::vector<double> read_list(const std::string& text, bool& ok) {
+    std::vector<double> values;
+    std::istringstream items(text);
+    std::string item;
+    double v;
+    while (std::getline(items, item, ',')) {
+        if (!read_number(item, v)) ok = false;
+        values.push_back(v);
+    }
+    return values;
+}
+
+static bool fail(BatchJob& job, const std::string& message) {
+    job.message = message;
+    return false;
+}
+
+static bool run_circuit(BatchJob& job, FILE* out) {
+    bool success;
+    std::string error;
+    Circuit c = Circuit::createFromFile(job.args[0].c_str(), success, error);
+    if (!success) return fail(job, error);
+    c.analyseCircuit(out);
+    return true;
+}
+
+/* Steps one component and re-solves incrementally, one CSV row per step */
+static bool run_sweep(BatchJob& job, FILE* out) {
+    double from, to, steps;
+    if (!read_number(job.args[2], from) || !read_number(job.args[3], to) || !read_number(job.args[4], steps) || steps < 0)
+        return fail(job, "expected <component> <from> <to> <steps>");
+    bool success;
+    std::string error;
+    Circuit c = Circuit::createFromFile(job.args[0].c_str(), success, error);
+    if (!success) return fail(job, error);
+    const char* name = job.args[1].c_str();
+
+    SinkOptions opts = default_sink_options(out);
+    opts.format = sink_csv;
+    ResultSink sink(opts, result_layout(c, name));
+    for (long k = 0; k <= (long)steps; k++) {
+        double value = steps > 0 ? from + (to - from) * k / (long)steps : from;
+        if (!c.setValue(name, value)) return fail(job, "no component " + job.args[1]);
+        sink.write(value, c.resolve());
+    }
+    if (!sink.finish()) return fail(job, "could not write " + job.output);
+    return true;
+}
+
+static bool run_logic(BatchJob& job, FILE* out) {
+    bool success;
+    LogicFile eqns = parse_file(job.args[0].c_str(), success);
+    if (!success) return fail(job, "could not open " + job.args[0]);
+    if (eqns.get_skipped()) return fail(job, std::to_string(eqns.get_skipped()) + " lines could not be parsed in " + job.args[0]);
+
+    std::vector<char> vars;
+    CharBitSet referenced = combine_vars(eqns);
+    while (char v = referenced.next_char()) vars.push_back(v);
+    std::sort(vars.begin(), vars.end());
+    if (vars.size() > 20) return fail(job, "too many variables for a truth table");
+
+    for (char v : vars) fprintf(out, "%c ", v);
+    fprintf(out, "|");
+    for (auto& eqn : eqns) fprintf(out, " %c", eqn.get_binding());
+    fprintf(out, "\n");
+
+    std::array<bool, 26> map;
+    map.fill(false);
+    for (unsigned long row = 0; row < (1ul << vars.size()); row++) {
+        for (size_t k = 0; k < vars.size(); k++) {
+            map[vars[k] - 'A'] = (row >> (vars.size() - 1 - k)) & 1;
+            fprintf(out, "%d ", map[vars[k] - 'A']);
+        }
+        fprintf(out, "|");
+        for (auto& eqn : eqns) fprintf(out, " %d", eqn.evaluate(map));
+        fprintf(out, "\n");
+    }
+    return true;
+}
+
+static bool run_plot(BatchJob& job, FILE* out) {
+    double f0 = 0.0, points = 0.0;
+    bool ok = read_number(job.args[0], f0) && read_number(job.args[1], points) && points >= 0;
+    std::vector<double> cos_coefs = read_list(job.args[2], ok), sin_coefs = read_list(job.args[3], ok);
+    if (!ok || cos_coefs.size() != sin_coefs.size())
+        return fail(job, "expected <f0> <points> and as many cos as sin coefficients");
+    if (!(f0 > 0.0)) return fail(job, "f0 must be positive");
+
+    FourierPlotter p(cos_coefs.size(), f0);
+    for (double c : cos_coefs) p.append_cos_coef(c);
+    for (double s : sin_coefs) p.append_sin_coef(s);
+    RenderOptions opts = default_render_options(out);
+    opts.mode = render_csv;
+    p.start_plotter((size_t)points, opts);
+    return true;
+}
+
+static double file_size(const std::string& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0.0 : (double)size;
+}
+
+static void write_json_string(FILE* out, const std::string& s) {
+    fputc('"', out);
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') fprintf(out, "\\%c", ch);
+        else if ((unsigned char)ch < 0x20) fprintf(out, "\\u%04x", ch);
+        else fputc(ch, out);
+    }
+    fputc('"', out);
+}
+
+int run_batch(const char* manifest, unsigned int workers, const char* out_dir, FILE* summary) {
+    std::vector<BatchJob> jobs;
+    if (!read_manifest(manifest, jobs)) return -1;
+    std::error_code ec;
+    std::filesystem::create_directories(out_dir, ec);
+    if (workers == 0) workers = worker_count();
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        BatchJob& job = jobs[i];
+        std::string stem = job.type == job_plot ? "plot" : std::filesystem::path(job.args[0]).stem().string();
+        char name[64];
+        snprintf(name, sizeof(name), "%03zu_%s_", i + 1, job_names[job.type]);
+        job.output = (std::filesystem::path(out_dir) / (name + stem + "." + job_extensions[job.type])).string();
+        switch (job.type) {
+            case job_circuit: case job_logic: job.weight = file_size(job.args[0]); break;
+            case job_sweep: job.weight = file_size(job.args[0]) * (1.0 + atof(job.args[4].c_str())); break;
+            case job_plot: job.weight = 8.0 * atof(job.args[1].c_str()); break;
+        }
+    }
+    std::vector<size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return jobs[a].weight > jobs[b].weight; });
+
+    Stopwatch total;
+    parallel_for_each(order.size(), workers, [&](size_t k) {
+        PROFILE_SCOPE("batch.job");
+        BatchJob& job = jobs[order[k]];
+        Stopwatch sw;
+        FILE* out = fopen(job.output.c_str(), "w");
+        if (!out) job.ok = fail(job, "could not open " + job.output);
+        else {
+            switch (job.type) {
+                case job_circuit: job.ok = run_circuit(job, out); break;
+                case job_sweep: job.ok = run_sweep(job, out); break;
+                case job_logic: job.ok = run_logic(job, out); break;
+                case job_plot: job.ok = run_plot(job, out); break;
+            }
+            if (fclose(out) != 0 && job.ok) job.ok = fail(job, "could not write " + job.output);
+        }
+        if (!job.ok) {
+            std::error_code ignored;
+            std::filesystem::remove(job.output, ignored);
+            job.output.clear();
+        }
+        job.seconds = sw.elapsed();
+    });
+    double wall = total.elapsed();
+
+    int failed = std::count_if(jobs.begin(), jobs.end(), [](const BatchJob& j) { return !j.ok; });
+    fprintf(summary, "{\"manifest\":");
+    write_json_string(summary, manifest);
+    fprintf(summary, ",\"workers\":%u,\"jobs\":%zu,\"failed\":%d,\"wall_s\":%.6f,\"results\":[", workers, jobs.size(), failed, wall);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        BatchJob& job = jobs[i];
+        fprintf(summary, "%s\n{\"job\":%zu,\"line\":%u,\"type\":\"%s\",\"input\":", i ? "," : "", i + 1, job.line, job_names[job.type]);
+        write_json_string(summary, job.type == job_plot ? "" : job.args[0]);
+        fprintf(summary, ",\"output\":");
+        write_json_string(summary, job.output);
+        fprintf(summary, ",\"status\":\"%s\",\"seconds\":%.6f", job.ok ? "ok" : "error", job.seconds);
+        if (!job.ok) {
+            fprintf(summary, ",\"message\":");
+            write_json_string(summary, job.message);
+        }
+        fprintf(summary, "}");
+    }
+    fprintf(summary, "\n]}\n");
+    fflush(summary);
+    return failed;
+}
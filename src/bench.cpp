@@ -0,0 +1,68 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+Stopwatch::Stopwatch(): start(std::chrono::steady_clock::now()) {}
+void Stopwatch::reset() { start = std::chrono::steady_clock::now(); }
+double Stopwatch::elapsed() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Stats summarize(std::vector<double> samples) {
+    Stats s = {0.0, 0.0, 0.0, 0.0};
+    if (samples.empty()) return s;
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+
+    s.min = samples[0];
+    s.median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    s.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+    double var = 0.0;
+    for (double x : samples) var += (x - s.mean) * (x - s.mean);
+    s.stddev = n > 1 ? sqrt(var / (n - 1)) : 0.0;
+    return s;
+}
+
+unsigned long long cycle_count() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool has_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+long peak_rss_kb() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024; /* bytes on macOS */
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+void print_stats_json(FILE* out, const char* name, Stats stats) {
+    fprintf(out, "\"%s\":{\"min\":%.9g,\"median\":%.9g,\"mean\":%.9g,\"stddev\":%.9g}",
+        name, stats.min, stats.median, stats.mean, stats.stddev);
+}
@@ -0,0 +1,240 @@
+#include <circuit.hpp>
+#include <bench.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    Circuit solver benchmark.
+
+    Generates synthetic netlists, then times parsing, assembly, factorization
+    and solving separately. Every case is reported as one JSON object per
+    line so runs can be diffed across solver changes.
+
+    Usage: bench_circuit [--kind ladder|grid2d|grid3d|random|subckt|flat|all]
+                         [--size N] [--reps R] [--seed S] [--out FILE]
+*/
+
+struct BenchCase {
+    std::string kind;
+    unsigned int size;
+};
+
+/* A chain of `n` series resistors with a resistor to ground at every tap */
+static void gen_ladder(FILE* f, unsigned int n) {
+    fprintf(f, "V1 1 0 1.0\n");
+    for (unsigned int i = 1; i <= n; i++) {
+        fprintf(f, "RS%u %u %u 1.0\n", i, i, i + 1);
+        fprintf(f, "RP%u %u 0 2.0\n", i, i + 1);
+    }
+}
+
+/* An n x n mesh of unit resistors driven across opposite corners */
+static void gen_grid2d(FILE* f, unsigned int n) {
+    auto id = [n](unsigned int x, unsigned int y) { return 1 + x + y * n; };
+    fprintf(f, "V1 %u 0 1.0\n", id(0, 0));
+    for (unsigned int y = 0; y < n; y++)
+        for (unsigned int x = 0; x < n; x++) {
+            if (x + 1 < n) fprintf(f, "RX%u_%u %u %u 1.0\n", x, y, id(x, y), id(x + 1, y));
+            if (y + 1 < n) fprintf(f, "RY%u_%u %u %u 1.0\n", x, y, id(x, y), id(x, y + 1));
+        }
+    fprintf(f, "RG %u 0 1.0\n", id(n - 1, n - 1));
+}
+
+/* An n x n x n lattice of unit resistors */
+static void gen_grid3d(FILE* f, unsigned int n) {
+    auto id = [n](unsigned int x, unsigned int y, unsigned int z) { return 1 + x + (y + z * n) * n; };
+    fprintf(f, "V1 %u 0 1.0\n", id(0, 0, 0));
+    for (unsigned int z = 0; z < n; z++)
+        for (unsigned int y = 0; y < n; y++)
+            for (unsigned int x = 0; x < n; x++) {
+                unsigned int a = id(x, y, z);
+                if (x + 1 < n) fprintf(f, "RX%u %u %u 1.0\n", a, a, id(x + 1, y, z));
+                if (y + 1 < n) fprintf(f, "RY%u %u %u 1.0\n", a, a, id(x, y + 1, z));
+                if (z + 1 < n) fprintf(f, "RZ%u %u %u 1.0\n", a, a, id(x, y, z + 1));
+            }
+    fprintf(f, "RG %u 0 1.0\n", id(n - 1, n - 1, n - 1));
+}
+
+/*
+    `n` nodes joined by a random spanning tree plus 2n random extra resistors,
+    so the graph is connected and the system is not singular.
+*/
+static void gen_random(FILE* f, unsigned int n, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> value(1.0, 1000.0);
+    fprintf(f, "V1 1 0 1.0\n");
+    fprintf(f, "I1 0 %u 0.001\n", n);
+    for (unsigned int i = 1; i <= n; i++) {
+        unsigned int parent = std::uniform_int_distribution<unsigned int>(0, i - 1)(rng);
+        fprintf(f, "RT%u %u %u %.6f\n", i, i, parent, value(rng));
+    }
+    std::uniform_int_distribution<unsigned int> node(0, n);
+    for (unsigned int i = 0; i < 2 * n; i++) {
+        unsigned int a = node(rng), b = node(rng);
+        if (a == b) continue;
+        fprintf(f, "RE%u %u %u %.6f\n", i, a, b, value(rng));
+    }
+}
+
+/*
+    A chain of `n` copies of a 6 x 6 resistor mesh, entered at one corner and
+    left at the opposite one, with a resistor to ground at every junction.
+    With `flat` every copy is written out; otherwise the mesh is a .subckt
+    and the chain is made of instances of it.
+*/
+static void gen_cells(FILE* f, unsigned int n, bool flat) {
+    const unsigned int k = 6, cell = k * k;
+    auto id = [k](unsigned int x, unsigned int y) { return 1 + x + y * k; };
+    auto mesh = [&](const char* prefix, auto node) {
+        for (unsigned int y = 0; y < k; y++)
+            for (unsigned int x = 0; x < k; x++) {
+                if (x + 1 < k) fprintf(f, "R%sX%u %u %u 1.0\n", prefix, id(x, y), node(id(x, y)), node(id(x + 1, y)));
+                if (y + 1 < k) fprintf(f, "R%sY%u %u %u 1.0\n", prefix, id(x, y), node(id(x, y)), node(id(x, y + 1)));
+            }
+    };
+
+    if (!flat) {
+        fprintf(f, ".subckt CELL %u %u\n", id(0, 0), id(k - 1, k - 1));
+        mesh("", [](unsigned int a) { return a; });
+        fprintf(f, ".ends\n");
+    }
+    fprintf(f, "V1 1 0 1.0\n");
+    for (unsigned int i = 1; i <= n; i++) {
+        if (flat) {
+            /* Junctions are 1..n+1, the inside of copy i follows them */
+            std::string prefix = std::to_string(i) + "_";
+            mesh(prefix.c_str(), [&](unsigned int a) {
+                if (a == id(0, 0)) return i;
+                if (a == id(k - 1, k - 1)) return i + 1;
+                return n + 1 + (i - 1) * cell + a;
+            });
+        }
+        else fprintf(f, "X%u %u %u CELL\n", i, i, i + 1);
+        fprintf(f, "RP%u %u 0 2.0\n", i, i + 1);
+    }
+}
+
+static bool generate(const BenchCase& bc, unsigned int seed, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    if (bc.kind == "ladder") gen_ladder(f, bc.size);
+    else if (bc.kind == "grid2d") gen_grid2d(f, bc.size);
+    else if (bc.kind == "grid3d") gen_grid3d(f, bc.size);
+    else if (bc.kind == "subckt") gen_cells(f, bc.size, false);
+    else if (bc.kind == "flat") gen_cells(f, bc.size, true);
+    else gen_random(f, bc.size, seed);
+    fclose(f);
+    return true;
+}
+
+/* ||A x - b||_2 / ||b||_2 */
+static double relative_residual(const std::vector<MatrixEntry>& A, Vector& x, Vector& b) {
+    Vector r = -b;
+    for (auto& e : A) r[e.row] += e.value * x[e.col];
+    double r2 = (r * r).sum(), b2 = (b * b).sum();
+    return b2 > 0.0 ? sqrt(r2 / b2) : sqrt(r2);
+}
+
+static void run_case(FILE* out, const BenchCase& bc, unsigned int reps, unsigned int seed, const std::string& dir) {
+    std::string path = dir + "/" + bc.kind + "_" + std::to_string(bc.size) + ".cir";
+    if (!generate(bc, seed, path)) { fprintf(stderr, "Could not write netlist: %s\n", path.c_str()); exit(EXIT_FAILURE); }
+
+    std::vector<double> t_parse, t_assemble, t_factor, t_solve, t_full;
+    Circuit c;
+    std::vector<MatrixEntry> A;
+    Vector Z, X;
+    LUFactor lu;
+    Stopwatch sw;
+
+    for (unsigned int r = 0; r < reps; r++) {
+        sw.reset();
+        c = Circuit::createFromFile(path.c_str());
+        t_parse.push_back(sw.elapsed());
+
+        sw.reset();
+        c.buildSystem(A, Z);
+        t_assemble.push_back(sw.elapsed());
+
+        sw.reset();
+        lu = LUFactor(c.systemSize(), A);
+        t_factor.push_back(sw.elapsed());
+
+        sw.reset();
+        X = lu.solve(Z);
+        t_solve.push_back(sw.elapsed());
+    }
+
+    /* Circuit::solve() end to end: islands, topology reduction, factor and solve */
+    CircuitSolution sol;
+    for (unsigned int r = 0; r < reps; r++) {
+        sw.reset();
+        sol = c.solve();
+        t_full.push_back(sw.elapsed());
+    }
+
+    Stats factor = summarize(t_factor);
+    fprintf(out, "{\"bench\":\"circuit\",\"kind\":\"%s\",\"size\":%u,\"nodes\":%u,\"unknowns\":%u,\"components\":%u,\"reps\":%u,",
+        bc.kind.c_str(), bc.size, c.nodeCount(), c.systemSize(), c.componentCount(), reps);
+    print_stats_json(out, "parse_s", summarize(t_parse));
+    fputc(',', out);
+    print_stats_json(out, "assemble_s", summarize(t_assemble));
+    fputc(',', out);
+    print_stats_json(out, "factor_s", factor);
+    fputc(',', out);
+    print_stats_json(out, "solve_s", summarize(t_solve));
+    fputc(',', out);
+    print_stats_json(out, "circuit_solve_s", summarize(t_full));
+    fprintf(out, ",\"reduced_unknowns\":%u", sol.reducedUnknowns);
+    fprintf(out, ",\"lu_entries\":%zu,\"factor_flops\":%.0f,\"solve_flops\":%.0f,\"factor_gflops\":%.4f,\"peak_rss_kb\":%ld,\"residual\":%.3e}\n",
+        lu.storedEntries(), lu.flops(), 2.0 * lu.storedEntries(), factor.median > 0.0 ? lu.flops() / factor.median * 1e-9 : 0.0,
+        peak_rss_kb(), relative_residual(A, X, Z));
+    fflush(out);
+}
+
+int main(int argc, char** argv) {
+    std::string kind = "all", dir = "build/bench";
+    unsigned int size = 0, reps = 3, seed = 1;
+    FILE* out = stdout;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_val = i + 1 < argc;
+        if (!strcmp(argv[i], "--kind") && has_val) kind = argv[++i];
+        else if (!strcmp(argv[i], "--size") && has_val) size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--reps") && has_val) reps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && has_val) seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--dir") && has_val) dir = argv[++i];
+        else if (!strcmp(argv[i], "--out") && has_val) {
+            out = fopen(argv[++i], "w");
+            if (!out) { fprintf(stderr, "Could not open file: %s\n", argv[i]); return 1; }
+        } else {
+            fprintf(stderr, "Usage: %s [--kind ladder|grid2d|grid3d|random|subckt|flat|all] [--size N] [--reps R] [--seed S] [--dir DIR] [--out FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps == 0) reps = 1;
+    std::filesystem::create_directories(dir);
+
+    /* Default sizes keep every case under a second or so */
+    std::vector<BenchCase> cases = {
+        {"ladder", 1000}, {"ladder", 100000},
+        {"grid2d", 30}, {"grid2d", 200},
+        {"grid3d", 10}, {"grid3d", 20},
+        {"random", 300}, {"random", 1000},
+        {"subckt", 1000}, {"flat", 1000},
+    };
+    for (auto& bc : cases) {
+        if (kind != "all" && bc.kind != kind) continue;
+        if (size) bc.size = size;
+        run_case(out, bc, reps, seed, dir);
+        if (size && kind != "all") break;
+    }
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
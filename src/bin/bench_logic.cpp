@@ -0,0 +1,224 @@
+#include <logic.hpp>
+#include <logic_arr.hpp>
+#include <bench.hpp>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    Logic evaluator benchmark.
+
+    Generates a random sum of products design and writes it both as a .logic
+    file and as an equivalent .larr PLA. Times parse_file,
+    Equation::evaluate, LogicMap::create_from_file and LogicMap::evaluate
+    with warm-up and repeated batches, and reports throughput plus cycles
+    per evaluation (rdtsc on x86, nanoseconds elsewhere) as JSON lines.
+
+    Usage: bench_logic [--inputs I] [--products P] [--outputs O] [--literals L]
+                       [--vectors V] [--reps R] [--seed S] [--dir DIR] [--out FILE]
+*/
+
+struct Design {
+    unsigned int inputs;
+    unsigned int products;
+    unsigned int outputs;
+    // literal[p * inputs + i]: 0 absent, 1 regular, 2 inverted
+    std::vector<uint8_t> literal;
+    // uses[o * products + p]: product p feeds output o
+    std::vector<uint8_t> uses;
+};
+
+static Design gen_design(unsigned int inputs, unsigned int products, unsigned int outputs,
+                         unsigned int literals, std::mt19937& rng) {
+    Design d = {inputs, products, outputs,
+                std::vector<uint8_t>(products * inputs, 0),
+                std::vector<uint8_t>(outputs * products, 0)};
+    std::uniform_int_distribution<unsigned int> input(0, inputs - 1), product(0, products - 1), coin(0, 1);
+    std::uniform_int_distribution<unsigned int> quarter(0, 3);
+
+    for (unsigned int p = 0; p < products; p++)
+        for (unsigned int l = 0; l < literals; l++)
+            d.literal[p * inputs + input(rng)] = 1 + coin(rng);
+
+    for (unsigned int o = 0; o < outputs; o++) {
+        for (unsigned int p = 0; p < products; p++)
+            d.uses[o * products + p] = quarter(rng) == 0;
+        d.uses[o * products + product(rng)] = 1;
+    }
+    return d;
+}
+
+/* One equation per output; bindings cycle through a-z past 26 outputs */
+static void write_logic(const Design& d, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) { fprintf(stderr, "Could not write: %s\n", path.c_str()); exit(EXIT_FAILURE); }
+    for (unsigned int o = 0; o < d.outputs; o++) {
+        fprintf(f, "%c =", 'a' + o % 26);
+        bool first = true;
+        for (unsigned int p = 0; p < d.products; p++) {
+            if (!d.uses[o * d.products + p]) continue;
+            fputs(first ? " " : " + ", f);
+            first = false;
+            for (unsigned int i = 0; i < d.inputs; i++) {
+                uint8_t lit = d.literal[p * d.inputs + i];
+                if (lit) fprintf(f, "%c%s", 'A' + i, lit == 2 ? "'" : "");
+            }
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+}
+
+static void write_larr(const Design& d, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) { fprintf(stderr, "Could not write: %s\n", path.c_str()); exit(EXIT_FAILURE); }
+    fprintf(f, "%u %u %u\n-\n", d.inputs, d.outputs, d.products);
+    for (unsigned int p = 0; p < d.products; p++) {
+        for (unsigned int i = 0; i < d.inputs; i++) {
+            uint8_t lit = d.literal[p * d.inputs + i];
+            fprintf(f, "%d %d ", lit == 2, lit == 1);
+        }
+        fputc('\n', f);
+    }
+    fputs("-\n", f);
+    for (unsigned int o = 0; o < d.outputs; o++) {
+        for (unsigned int p = 0; p < d.products; p++) fprintf(f, "%d ", d.uses[o * d.products + p]);
+        fputc('\n', f);
+    }
+    fclose(f);
+}
+
+struct Timing {
+    std::vector<double> seconds;
+    std::vector<double> cycles;
+};
+
+/* Runs `body` `warmup` times untimed, then `reps` timed batches */
+template <typename F>
+static Timing measure(unsigned int warmup, unsigned int reps, F body) {
+    Timing t;
+    for (unsigned int i = 0; i < warmup; i++) body();
+    Stopwatch sw;
+    for (unsigned int i = 0; i < reps; i++) {
+        sw.reset();
+        unsigned long long c0 = cycle_count();
+        body();
+        unsigned long long c1 = cycle_count();
+        t.seconds.push_back(sw.elapsed());
+        t.cycles.push_back((double)(c1 - c0));
+    }
+    return t;
+}
+
+/* `items` is the work done per batch: bytes for parsing, evaluations otherwise */
+static void report(FILE* out, const char* op, const Design& d, const Timing& t,
+                   double items, const char* unit, double vectors) {
+    Stats sec = summarize(t.seconds), cyc = summarize(t.cycles);
+    fprintf(out, "{\"bench\":\"logic\",\"op\":\"%s\",\"inputs\":%u,\"products\":%u,\"outputs\":%u,\"reps\":%zu,",
+        op, d.inputs, d.products, d.outputs, t.seconds.size());
+    print_stats_json(out, "batch_s", sec);
+    fprintf(out, ",\"%ss_per_s\":%.6g", unit, sec.median > 0.0 ? items / sec.median : 0.0);
+    if (vectors > 0.0) fprintf(out, ",\"vectors_per_s\":%.6g", sec.median > 0.0 ? vectors / sec.median : 0.0);
+    fprintf(out, ",\"%s_per_%s\":%.4g}\n", has_cycle_counter() ? "cycles" : "ns", unit,
+        items > 0.0 ? cyc.median / items : 0.0);
+    fflush(out);
+}
+
+int main(int argc, char** argv) {
+    unsigned int inputs = 16, products = 32, outputs = 8, literals = 4;
+    unsigned int vectors = 4096, reps = 10, warmup = 2, seed = 1;
+    std::string dir = "build/bench";
+    FILE* out = stdout;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_val = i + 1 < argc;
+        if (!strcmp(argv[i], "--inputs") && has_val) inputs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--products") && has_val) products = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--outputs") && has_val) outputs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--literals") && has_val) literals = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--vectors") && has_val) vectors = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--reps") && has_val) reps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && has_val) seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--dir") && has_val) dir = argv[++i];
+        else if (!strcmp(argv[i], "--out") && has_val) {
+            out = fopen(argv[++i], "w");
+            if (!out) { fprintf(stderr, "Could not open file: %s\n", argv[i]); return 1; }
+        } else {
+            fprintf(stderr, "Usage: %s [--inputs I] [--products P] [--outputs O] [--literals L] "
+                "[--vectors V] [--reps R] [--seed S] [--dir DIR] [--out FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    /* .logic variables are limited to A-Z */
+    if (inputs < 1 || inputs > 26) { fprintf(stderr, "--inputs must be between 1 and 26\n"); return 1; }
+    if (products < 1 || outputs < 1 || vectors < 1) { fprintf(stderr, "Sizes must be positive\n"); return 1; }
+    if (reps == 0) reps = 1;
+    if (literals > inputs) literals = inputs;
+    if (literals == 0) literals = 1;
+
+    std::filesystem::create_directories(dir);
+    std::mt19937 rng(seed);
+    Design d = gen_design(inputs, products, outputs, literals, rng);
+    std::string stem = dir + "/logic_" + std::to_string(inputs) + "_" + std::to_string(products) + "_" + std::to_string(outputs);
+    std::string logic_path = stem + ".logic", larr_path = stem + ".larr";
+    write_logic(d, logic_path);
+    write_larr(d, larr_path);
+    double file_bytes = (double)std::filesystem::file_size(logic_path);
+    double larr_bytes = (double)std::filesystem::file_size(larr_path);
+
+    /* Random input vectors, laid out for both evaluators */
+    std::vector<std::array<bool, 26>> eq_inputs(vectors);
+    std::uniform_int_distribution<int> coin(0, 1);
+    for (unsigned int v = 0; v < vectors; v++) {
+        eq_inputs[v].fill(false);
+        for (unsigned int i = 0; i < inputs; i++) eq_inputs[v][i] = coin(rng);
+    }
+    std::vector<std::array<bool, 26>> map_inputs = eq_inputs;
+
+    bool success;
+    LogicFile eqns;
+    Timing t = measure(warmup, reps, [&]() { eqns = parse_file(logic_path.c_str(), success); });
+    if (!success || eqns.size() != outputs) { fprintf(stderr, "Could not parse %s\n", logic_path.c_str()); return 1; }
+    report(out, "parse_file", d, t, file_bytes, "byte", 0.0);
+
+    volatile unsigned long sink = 0;
+    t = measure(warmup, reps, [&]() {
+        unsigned long count = 0;
+        for (unsigned int v = 0; v < vectors; v++)
+            for (auto& eqn : eqns) count += eqn.evaluate(eq_inputs[v]);
+        sink = sink + count;
+    });
+    report(out, "equation_evaluate", d, t, (double)vectors * outputs, "eval", vectors);
+
+    LogicMap map;
+    t = measure(warmup, reps, [&]() { map = LogicMap::create_from_file(larr_path.c_str(), success); });
+    if (!success) { fprintf(stderr, "Could not parse %s\n", larr_path.c_str()); return 1; }
+    report(out, "logicmap_create_from_file", d, t, larr_bytes, "byte", 0.0);
+
+    t = measure(warmup, reps, [&]() {
+        unsigned long count = 0;
+        for (unsigned int v = 0; v < vectors; v++) {
+            std::span<bool> values(map_inputs[v].data(), inputs);
+            for (unsigned int o = 0; o < outputs; o++) count += map.evaluate(values, o);
+        }
+        sink = sink + count;
+    });
+    report(out, "logicmap_evaluate", d, t, (double)vectors * outputs, "eval", vectors);
+
+    /* Both evaluators describe the same design, so they must agree */
+    unsigned long mismatches = 0;
+    for (unsigned int v = 0; v < vectors; v++) {
+        std::span<bool> values(map_inputs[v].data(), inputs);
+        for (unsigned int o = 0; o < outputs; o++)
+            mismatches += eqns[o].evaluate(eq_inputs[v]) != map.evaluate(values, o);
+    }
+    if (mismatches) fprintf(stderr, "Evaluators disagree on %lu results\n", mismatches);
+
+    if (out != stdout) fclose(out);
+    return mismatches != 0;
+}
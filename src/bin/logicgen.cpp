@@ -0,0 +1,47 @@
+#include <logic.hpp>
+#include <logic_arr.hpp>
+#include <logic_gen.hpp>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+/*
+    Writes a header of specialized evaluators for a .logic or .larr design.
+
+    Usage: logicgen <design> <header> [--name NAMESPACE]
+*/
+int main(int argc, char** argv) {
+    const char* design = nullptr;
+    const char* header = nullptr;
+    std::string name;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--name") && i + 1 < argc) name = argv[++i];
+        else if (!design) design = argv[i];
+        else if (!header) header = argv[i];
+        else design = nullptr, i = argc;
+    }
+    if (!design || !header) {
+        fprintf(stderr, "Usage: %s <file.logic|file.larr> <header> [--name NAMESPACE]\n", argv[0]);
+        return 1;
+    }
+    if (name.empty()) name = logic_header_name(design);
+
+    std::string ext = std::filesystem::path(design).extension().string();
+    if (ext != ".logic" && ext != ".larr") { fprintf(stderr, "Unknown design type: %s\n", design); return 1; }
+
+    bool success;
+    LogicFile eqns;
+    LogicMap map;
+    if (ext == ".logic") eqns = parse_file(design, success);
+    else map = LogicMap::create_from_file(design, success);
+    if (!success) { fprintf(stderr, "Could not open file: %s\n", design); return 1; }
+
+    FILE* out = fopen(header, "w");
+    if (!out) { fprintf(stderr, "Could not open file: %s\n", header); return 1; }
+    if (ext == ".logic") write_logic_header(eqns, name.c_str(), design, out);
+    else write_logic_map_header(map, name.c_str(), design, out);
+    fclose(out);
+    return 0;
+}
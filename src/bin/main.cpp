@@ -5,16 +5,90 @@
 #include <string_view>
 #include <regex>
 #include <bitset>
+#include <batch.hpp>
 #include <circuit.hpp>
+#include <fft.hpp>
 #include <plotter.hpp>
 #include <logic.hpp>
+#include <profile.hpp>
+#include <result_sink.hpp>
+#include <server.hpp>
 
 void plotter();
 void circuit_sim();
 void logic();
 bool main_menu();
+int solve_to_file(const char* netlist, const char* results, char** sweep);
+int fourier_from_file(const char* waveform, size_t harmonics, double periods, fft_window window,
+                      size_t block, size_t hop, size_t plot_points);
+
+int main(int argc, char** argv) {
+    const char* manifest = nullptr;
+    const char* out_dir = "batch_out";
+    const char* summary_path = nullptr;
+    unsigned int jobs = 0;
+    const char* serve_path = nullptr;
+    size_t cache_entries = DEFAULT_CACHE_ENTRIES;
+    const char* netlist = nullptr;
+    const char* results = nullptr;
+    char** sweep = nullptr;
+    const char* waveform = nullptr;
+    size_t harmonics = 16, block = 0, hop = 0, plot_points = 0;
+    double periods = 1.0;
+    fft_window window = window_rect;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_val = i + 1 < argc;
+        if (!strcmp(argv[i], "--profile") && has_val && profile_start(argv[i + 1])) i++;
+        else if (!strcmp(argv[i], "--batch") && has_val) manifest = argv[++i];
+        else if (!strcmp(argv[i], "-j") && has_val) jobs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--out") && has_val) out_dir = argv[++i];
+        else if (!strcmp(argv[i], "--summary") && has_val) summary_path = argv[++i];
+        else if (!strcmp(argv[i], "--solve") && has_val) netlist = argv[++i];
+        else if (!strcmp(argv[i], "--results") && has_val) results = argv[++i];
+        else if (!strcmp(argv[i], "--sweep") && i + 4 < argc) { sweep = argv + i + 1; i += 4; }
+        else if (!strcmp(argv[i], "--serve") && has_val) serve_path = argv[++i];
+        else if (!strcmp(argv[i], "--cache") && has_val) cache_entries = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--fourier") && has_val) waveform = argv[++i];
+        else if (!strcmp(argv[i], "--harmonics") && has_val) harmonics = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--periods") && has_val) periods = strtod(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "--window") && has_val && parse_window(argv[i + 1], window)) i++;
+        else if (!strcmp(argv[i], "--block") && has_val) block = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--hop") && has_val) hop = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--plot") && has_val) plot_points = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--query") && i + 2 < argc) {
+            /* Everything after the socket path is the request */
+            std::string request;
+            for (int k = i + 2; k < argc; k++) request += (k > i + 2 ? " " : "") + std::string(argv[k]);
+            return query_server(argv[i + 1], request, stdout);
+        } else {
+            fprintf(stderr, "Usage: %s [--profile summary|trace|trace:<file>]\n"
+                "       %s --batch <manifest> [-j N] [--out DIR] [--summary FILE]\n"
+                "       %s --solve <netlist> --results FILE [--sweep <component> <from> <to> <steps>]\n"
+                "       %s --serve <socket> [--cache N]\n"
+                "       %s --query <socket> <request...>\n"
+                "       %s --fourier <waveform> [--harmonics K] [--periods P] [--window rect|hann|hamming|blackman]\n"
+                "           [--block N [--hop H]] [--plot POINTS]\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    /* Batch mode: run the manifest without the menu */
+    if (manifest) {
+        FILE* summary = summary_path ? fopen(summary_path, "w") : stdout;
+        if (!summary) { fprintf(stderr, "Could not open file: %s\n", summary_path); return 1; }
+        int failed = run_batch(manifest, jobs, out_dir, summary);
+        if (summary != stdout) fclose(summary);
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (serve_path) return run_server(serve_path, cache_entries);
+    if (netlist || results) {
+        if (!netlist || !results) { fprintf(stderr, "--solve and --results go together\n"); return 1; }
+        return solve_to_file(netlist, results, sweep);
+    }
+    if (waveform) return fourier_from_file(waveform, harmonics, periods, window, block, hop, plot_points);
 
-int main() {
     while (main_menu());
     printf("Thank you for using Cajun5im\n");
 
@@ -47,14 +121,14 @@ void logic() {
     std::string filename;
     std::cin >> filename;
     bool success;
-    std::vector<Equation> eqns = parse_file(filename.c_str(), success);
+    LogicFile eqns = parse_file(filename.c_str(), success);
     if (!success) { printf("File could not be opened"); return; }
     CharBitSet vars = combine_vars(eqns);
     std::array<bool, 26> map;
     std::fill(std::begin(map), std::end(map), false);
 
     printf("Bindings loaded:");
-    for (auto eqn : eqns) {
+    for (auto& eqn : eqns) {
         printf(" %c", eqn.get_binding());
     }
     printf("\n\n");
@@ -70,7 +144,7 @@ void logic() {
         if (input == "q" || input == "Q") break;
         else if (input == "listb") {
             printf("Bindings loaded:");
-            for (auto eqn : eqns) {
+            for (auto& eqn : eqns) {
                 printf(" %c", eqn.get_binding());
             }
             printf("\n");
@@ -111,6 +185,76 @@ void logic() {
     }
 }
 
+/* Writes the solution, or one row per sweep step, as CSV (.csv) or binary results */
+int solve_to_file(const char* netlist, const char* results, char** sweep) {
+    double from = 0.0, to = 0.0;
+    long steps = 0;
+    if (sweep) {
+        char* end[3];
+        from = strtod(sweep[1], &end[0]);
+        to = strtod(sweep[2], &end[1]);
+        steps = strtol(sweep[3], &end[2], 10);
+        if (*end[0] || *end[1] || *end[2] || steps < 0) { fprintf(stderr, "Expected --sweep <component> <from> <to> <steps>\n"); return 1; }
+    }
+    /* Load and check everything before the results file is created */
+    bool success;
+    std::string error;
+    Circuit c = Circuit::createFromFile(netlist, success, error);
+    if (!success) { fprintf(stderr, "%s\n", error.c_str()); return 1; }
+    if (sweep && !c.setValue(sweep[0], from)) { fprintf(stderr, "No component named %s\n", sweep[0]); return 1; }
+
+    FILE* out = fopen(results, "wb");
+    if (!out) { fprintf(stderr, "Could not open file: %s\n", results); return 1; }
+    bool written;
+    {
+        ResultSink sink(default_sink_options(out, results), result_layout(c, sweep ? sweep[0] : "solution"));
+        if (!sweep) sink.write(0.0, c.solve());
+        for (long k = 0; sweep && k <= steps; k++) {
+            double value = steps > 0 ? from + (to - from) * k / steps : from;
+            c.setValue(sweep[0], value);
+            sink.write(value, c.resolve());
+        }
+        written = sink.finish();
+    }
+    if (fclose(out) != 0) written = false;
+    if (!written) { fprintf(stderr, "Could not write file: %s\n", results); return 1; }
+    return 0;
+}
+
+/*
+    Prints the Fourier coefficients of a waveform file, or with `block` set
+    one row of coefficients per block. `plot_points` plots the series.
+*/
+int fourier_from_file(const char* waveform, size_t harmonics, double periods, fft_window window,
+                      size_t block, size_t hop, size_t plot_points) {
+    std::vector<double> samples;
+    double dx, x0;
+    if (!(periods >= 1.0)) { fprintf(stderr, "--periods must be at least 1\n"); return 1; }
+    if (!read_waveform(waveform, samples, dx, x0)) return 1;
+
+    if (block) {
+        BlockAnalyzer analyzer(block, hop ? hop : block, harmonics, periods, window, dx, x0,
+            [x0, dx](size_t start, const FourierSeries& s) {
+                printf("%g", x0 + start * dx);
+                for (size_t k = 0; k < s.cos_coefs.size(); k++) printf(",%g,%g", s.cos_coefs[k], s.sin_coefs[k]);
+                printf("\n");
+            });
+        printf("x");
+        for (size_t k = 0; k < harmonics; k++) printf(",cos%zu,sin%zu", k, k);
+        printf("\n");
+        analyzer.push(samples);
+        if (analyzer.get_blocks() == 0) { fprintf(stderr, "Fewer than %zu samples in %s\n", block, waveform); return 1; }
+        return 0;
+    }
+
+    FourierSeries series = fourier_coefficients(samples, dx, harmonics, periods, window, x0);
+    printf("f0 = %g\n", series.f0);
+    for (size_t k = 0; k < series.cos_coefs.size(); k++)
+        printf("%3zu %12.6g %12.6g\n", k, series.cos_coefs[k], series.sin_coefs[k]);
+    if (plot_points) to_plotter(series).start_plotter(plot_points);
+    return 0;
+}
+
 void circuit_sim() {
     Circuit c;
 
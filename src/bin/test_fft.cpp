@@ -0,0 +1,66 @@
+#include <fft.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/* Largest difference from a direct O(n^2) DFT of a fixed test signal */
+static double dft_error(size_t n) {
+    std::vector<double> re(n), im(n);
+    for (size_t j = 0; j < n; j++) {
+        re[j] = sin(0.37 * j) + 0.25 * cos(1.9 * j * j);
+        im[j] = cos(0.11 * j) - 0.5;
+    }
+    std::vector<double> fr(re), fi(im);
+    fft_plan(n)->forward(fr.data(), fi.data());
+
+    double err = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        long double sr = 0.0, si = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            long double a = -2.0L * PI * (long double)(j * k % n) / n;
+            sr += re[j] * cosl(a) - im[j] * sinl(a);
+            si += re[j] * sinl(a) + im[j] * cosl(a);
+        }
+        err = std::max(err, (double)std::max(fabsl(sr - fr[k]), fabsl(si - fi[k])));
+    }
+    return err;
+}
+
+int main() {
+    // Powers of two, mixed radix and primes (Bluestein)
+    for (size_t n : {1, 2, 8, 12, 60, 64, 97, 100, 243, 250, 1000, 1009}) printf("n = %4zu: max error %.2e\n", n, dft_error(n));
+
+    /* Recover the coefficients test_plotter draws from its samples */
+    const size_t count = 8;
+    const double f0 = 2.67;
+    FourierPlotter plotter(count, f0);
+    for (size_t i = 0; i < count; i++) plotter.append_cos_coef(0.0);
+    for (size_t i = 0; i < count; i++) plotter.append_sin_coef((double)(i * i + 1) / (double)((2 * i + 1) * (2 * i + 1)));
+
+    // 3 periods of 360 / 2.67 samples, sampled 4000 times
+    const size_t n = 4000, periods = 3;
+    double dx = periods * 360.0 / f0 / n;
+    std::vector<double> samples(n);
+    plotter.synthesize(0.0, dx, samples);
+    FourierSeries series = fourier_coefficients(samples, dx, count, periods);
+    printf("f0 = %.6f\n", series.f0);
+    for (size_t k = 0; k < count; k++)
+        printf("k = %zu: cos %9.6f sin %9.6f\n", k, series.cos_coefs[k], series.sin_coefs[k]);
+
+    /* 4200 samples span 3.15 periods; the first 3, 4000 samples, are analysed */
+    std::vector<double> longer(4200);
+    plotter.synthesize(0.0, dx, longer);
+    FourierSeries trimmed = fourier_coefficients(longer, dx, count, 3.15);
+    printf("3.15 periods: f0 = %.6f sin1 %9.6f sin7 %9.6f\n", trimmed.f0, trimmed.sin_coefs[1], trimmed.sin_coefs[7]);
+
+    /* Streaming, Hann windowed blocks of the same signal */
+    std::vector<double> capture(n * 4);
+    plotter.synthesize(0.0, dx, capture);
+    BlockAnalyzer analyzer(n, n / 2, count, periods, window_hann, dx, 0.0, [](size_t start, const FourierSeries& s) {
+        printf("block at %5zu: sin1 %9.6f sin3 %9.6f\n", start, s.sin_coefs[1], s.sin_coefs[3]);
+    });
+    for (size_t at = 0; at < capture.size(); at += 1500)
+        analyzer.push(std::span<const double>(capture).subspan(at, std::min<size_t>(1500, capture.size() - at)));
+    printf("blocks = %zu\n", analyzer.get_blocks());
+}
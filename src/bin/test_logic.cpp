@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <iostream>
 #include <bitset>
+#include <array>
 
 /* 
 Write `val` into the values at the given character indices 
@@ -17,6 +18,51 @@ void write_val(uint32_t val, CharBitSet vars, std::span<bool> values) {
     }
 }
 
+static std::array<bool, 26> assign(const char* ones) {
+    std::array<bool, 26> map;
+    map.fill(false);
+    for (; *ones; ones++) map[*ones - 'A'] = true;
+    return map;
+}
+
+/*
+    Parses `text` and checks the equation and skipped line counts, and that
+    binding `binding` evaluates to `expected` with the variables in `ones` set.
+    Returns the number of failures.
+*/
+static int check_parse(const char* name, const char* text, size_t equations, size_t skipped,
+                       char binding, const char* ones, bool expected) {
+    LogicFile eqns;
+    eqns.parse(text);
+    auto map = assign(ones);
+    int idx = search_binding(eqns, binding);
+    bool ok = eqns.size() == equations && eqns.get_skipped() == skipped && idx != -1 && eqns[idx].evaluate(map) == expected;
+    printf("%s: %zu equations, %zu skipped, %s\n", name, eqns.size(), eqns.get_skipped(), ok ? "ok" : "FAIL");
+    return !ok;
+}
+
+/* Copies must keep working once the original is reparsed (its arena moves) and destroyed */
+static int check_copies() {
+    LogicFile* original = new LogicFile();
+    original->parse("x = AB + C'\ny = A'B\n");
+    LogicFile copy(*original);
+    LogicFile assigned;
+    assigned.parse("z = D\n");
+    assigned = *original;
+    for (int i = 0; i < 64; i++) original->parse("w = ABCDEFGH + IJKLMNOP\n");
+    delete original;
+
+    int failures = 0;
+    for (LogicFile* eqns : {&copy, &assigned}) {
+        auto map = assign("AB");
+        bool ok = eqns->size() == 2 && eqns->get_skipped() == 0 && search_binding(*eqns, 'z') == -1
+            && (*eqns)[search_binding(*eqns, 'x')].evaluate(map) && !(*eqns)[search_binding(*eqns, 'y')].evaluate(map);
+        printf("%s: %s\n", eqns == &copy ? "copy" : "assignment", ok ? "ok" : "FAIL");
+        failures += !ok;
+    }
+    return failures;
+}
+
 int main() {
     std::array<bool, 26> map;
     std::fill(std::begin(map), std::end(map), false);
@@ -37,6 +83,13 @@ int main() {
         printf("x = %u\n", eqns[0].evaluate(map));
         std::fill(std::begin(map), std::end(map), false);
     }
+
+    int failures = 0;
+    failures += check_parse("crlf", "x = AB\r\ny = A' + C\r\n", 2, 0, 'y', "C", true);
+    failures += check_parse("bad then good", "x = 1B\ny = AB\n", 1, 1, 'y', "AB", true);
+    failures += check_parse("trailing plus", "x = AB +\ny = C\nz = D +", 1, 2, 'y', "", false);
+    failures += check_copies();
+    return failures == 0 ? 0 : 1;
 }
 
 
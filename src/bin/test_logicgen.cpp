@@ -0,0 +1,69 @@
+#include <logic.hpp>
+#include <logic_arr.hpp>
+#include <gen/ex1.logic.hpp>
+#include <gen/ex1.larr.hpp>
+#include <stdio.h>
+#include <cstdint>
+#include <functional>
+
+// The evaluators run at compile time: A = B = 1, C = 0 satisfies the term ABC' of x
+static_assert(ex1_logic::evaluate(0b011) == 1);
+
+/*
+    Compares a generated header's `evaluate` and `evaluate_sliced` with the
+    interpreter over every input vector. `reference(v, o)` is output o of
+    vector v, where bit i of v is input i. Returns the number of mismatches.
+*/
+static unsigned long check(const char* name, unsigned int inputs, unsigned int outputs,
+                           std::uint64_t (*evaluate)(std::uint64_t),
+                           void (*evaluate_sliced)(const std::uint64_t*, std::uint64_t*),
+                           const std::function<bool(std::uint64_t, unsigned int)>& reference) {
+    const std::uint64_t vectors = 1ull << inputs;
+    unsigned long mismatches = 0;
+    std::vector<std::uint64_t> in(inputs), out(outputs);
+    for (std::uint64_t base = 0; base < vectors; base += 64) {
+        /* Slice i holds input i of vectors base .. base + 63 */
+        for (unsigned int i = 0; i < inputs; i++) {
+            in[i] = 0;
+            for (unsigned int j = 0; j < 64; j++) in[i] |= (((base + j) >> i) & 1) << j;
+        }
+        evaluate_sliced(in.data(), out.data());
+
+        for (std::uint64_t v = base; v < vectors && v < base + 64; v++) {
+            std::uint64_t packed = evaluate(v);
+            for (unsigned int o = 0; o < outputs; o++) {
+                bool expected = reference(v, o);
+                if (((packed >> o) & 1) != expected) mismatches++;
+                if (((out[o] >> (v - base)) & 1) != expected) mismatches++;
+            }
+        }
+    }
+    printf("%s: %llu vectors x %u outputs, %lu mismatches\n", name, (unsigned long long)vectors, outputs, mismatches);
+    return mismatches;
+}
+
+int main() {
+    bool success;
+    LogicFile eqns = parse_file("res/ex1.logic", success);
+    if (!success) { printf("Could not open res/ex1.logic\n"); return 1; }
+    LogicMap map = LogicMap::create_from_file("res/ex1.larr", success);
+    if (!success) { printf("Could not open res/ex1.larr\n"); return 1; }
+
+    unsigned long mismatches = check("ex1.logic", ex1_logic::num_inputs, ex1_logic::num_outputs,
+        ex1_logic::evaluate, ex1_logic::evaluate_sliced, [&](std::uint64_t v, unsigned int o) {
+            std::array<bool, 26> values;
+            values.fill(false);
+            for (unsigned int i = 0; i < ex1_logic::num_inputs; i++)
+                values[ex1_logic::input_names[i][0] - 'A'] = (v >> i) & 1;
+            return eqns[search_binding(eqns, ex1_logic::output_names[o][0])].evaluate(values);
+        });
+
+    mismatches += check("ex1.larr", ex1_larr::num_inputs, ex1_larr::num_outputs,
+        ex1_larr::evaluate, ex1_larr::evaluate_sliced, [&](std::uint64_t v, unsigned int o) {
+            bool values[ex1_larr::num_inputs];
+            for (unsigned int i = 0; i < ex1_larr::num_inputs; i++) values[i] = (v >> i) & 1;
+            return map.evaluate(std::span<bool>(values, ex1_larr::num_inputs), o);
+        });
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -1,8 +1,41 @@
 #include <plotter.hpp>
+#include <renderer.hpp>
+#include <cstring>
+#include <vector>
 
-int main() {
-    int count = 8;
-    FourierPlotter plotter(count, 2.67);
+static double maxDifference(FourierPlotter& plotter, const std::vector<double>& xs, const std::vector<double>& ys) {
+    double err = 0.0;
+    for (size_t k = 0; k < xs.size(); k++) err = fmax(err, fabs(ys[k] - plotter.sample(xs[k])));
+    return err;
+}
+
+/*
+    Largest difference between the batch paths and scalar sample(). The runs
+    are long enough to cross the synthesizer's reseed points and the thread
+    chunks, and start off the integer grid.
+*/
+static double batchError(FourierPlotter& plotter, const char* name) {
+    const size_t n = 40000;
+    std::vector<double> xs(n), ys(n);
+
+    for (size_t k = 0; k < n; k++) xs[k] = -5000.0 + k * 0.37 + (k % 7) * 0.011;
+    plotter.sample_many(xs, ys);
+    double many = maxDifference(plotter, xs, ys);
+
+    for (size_t k = 0; k < n; k++) xs[k] = 0.5 + k * 0.37;
+    plotter.synthesize(0.5, 0.37, ys);
+    double synth = maxDifference(plotter, xs, ys);
+
+    for (size_t k = 0; k < n; k++) xs[k] = -12345.0 + k;
+    plotter.sample_range(-12345, ys);
+    double range = maxDifference(plotter, xs, ys);
+
+    printf("%s: sample_many %.2e, synthesize %.2e, sample_range %.2e\n", name, many, synth, range);
+    return fmax(many, fmax(synth, range));
+}
+
+static FourierPlotter makePlotter(int count, double f0) {
+    FourierPlotter plotter(count, f0);
     int ccount = count;
     while(ccount-->0) plotter.append_cos_coef(0.0);
 
@@ -10,6 +43,32 @@ int main() {
         double coef = (double)(i * i + 1) / (double)((2 * i + 1)*(2 * i + 1));
         plotter.append_sin_coef(coef);
     }
-    plotter.start_plotter(400000);
+    return plotter;
+}
+
+// Usage: test_plotter [csv|bin <file>]
+int main(int argc, char** argv) {
+    int count = 8;
+    FourierPlotter plotter = makePlotter(count, 2.67);
+
+    /* 360/2.67 is not a whole number: the cache holds 89 periods. 360/3.6 is, and 360/0.7071 never lines up */
+    double err = batchError(plotter, "f0 = 2.67");
+    FourierPlotter whole = makePlotter(count, 3.6), uncached = makePlotter(count, 0.7071);
+    err = fmax(err, batchError(whole, "f0 = 3.6"));
+    err = fmax(err, batchError(uncached, "f0 = 0.7071"));
+    printf("batch vs sample: max difference %.2e\n", err);
+    if (!(err < 1e-9)) return 1;
+
+    if (argc < 3) {
+        plotter.start_plotter(400000);
+        return 0;
+    }
+
+    RenderOptions opts = default_render_options();
+    opts.mode = strcmp(argv[1], "bin") == 0 ? render_binary : render_csv;
+    opts.out = fopen(argv[2], "wb");
+    if (!opts.out) { fprintf(stderr, "Could not open file: %s\n", argv[2]); return 1; }
+    plotter.start_plotter(400000, opts);
+    fclose(opts.out);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,117 @@
+#include <result_sink.hpp>
+#include <stdio.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+static const long STEPS = 2000;
+
+/* Sweeps R2 of example1 into a temporary file and returns the bytes written */
+static std::string sweep(sink_format format, bool async) {
+    Circuit c = Circuit::createFromFile("res/example1.cir");
+    FILE* out = tmpfile();
+    if (!out) return "";
+    SinkOptions opts = default_sink_options(out);
+    opts.format = format;
+    opts.async = async;
+    opts.max_pending = 16;
+    {
+        ResultSink sink(opts, result_layout(c, "R2"));
+        for (long k = 0; k <= STEPS; k++) {
+            c.setValue("R2", 1000.0 + k);
+            sink.write(1000.0 + k, c.resolve());
+        }
+        if (!sink.finish()) printf("finish() reported a write failure\n");
+    }
+    std::string bytes;
+    rewind(out);
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), out)) > 0) bytes.append(chunk, n);
+    fclose(out);
+    return bytes;
+}
+
+/* Reads `n` bytes at `pos` into `dst`, false past the end */
+static bool take(const std::string& bytes, size_t& pos, void* dst, size_t n) {
+    if (pos + n > bytes.size()) return false;
+    memcpy(dst, bytes.data() + pos, n);
+    pos += n;
+    return true;
+}
+
+static bool take_name(const std::string& bytes, size_t& pos, std::string& name) {
+    std::uint32_t len;
+    if (!take(bytes, pos, &len, sizeof(len)) || pos + len > bytes.size()) return false;
+    name = bytes.substr(pos, len);
+    pos += len;
+    return true;
+}
+
+/* Parses the binary format back and checks it against the circuit's layout. Returns the number of failures */
+static int check_binary(const std::string& bytes) {
+    Circuit c = Circuit::createFromFile("res/example1.cir");
+    ResultLayout layout = result_layout(c, "R2");
+    int failures = 0;
+    size_t pos = 0;
+
+    char magic[8];
+    std::uint32_t nodes = 0, currents = 0;
+    std::string point_name;
+    if (!take(bytes, pos, magic, 8) || memcmp(magic, "CAJRES1\n", 8)) { printf("binary: bad magic\n"); return 1; }
+    take(bytes, pos, &nodes, sizeof(nodes));
+    take(bytes, pos, &currents, sizeof(currents));
+    if (nodes != layout.nodes.size() || currents != layout.currents.size()) {
+        printf("binary: %u nodes, %u currents, expected %zu, %zu\n", nodes, currents, layout.nodes.size(), layout.currents.size());
+        return 1;
+    }
+    if (!take_name(bytes, pos, point_name) || point_name != "R2") { printf("binary: point name '%s'\n", point_name.c_str()); failures++; }
+    for (std::uint32_t k = 0; k < nodes; k++) {
+        std::uint32_t label = 0;
+        if (!take(bytes, pos, &label, sizeof(label)) || label != layout.labels[k]) { printf("binary: label %u is %u\n", k, label); failures++; }
+    }
+    for (std::uint32_t k = 0; k < currents; k++) {
+        std::string name;
+        if (!take_name(bytes, pos, name) || name != layout.currents[k]) { printf("binary: current %u is '%s'\n", k, name.c_str()); failures++; }
+    }
+
+    size_t row_bytes = (1 + nodes + currents) * sizeof(double);
+    size_t rows = (bytes.size() - pos) / row_bytes;
+    if (rows != STEPS + 1 || (bytes.size() - pos) % row_bytes) { printf("binary: %zu bytes of rows, expected %ld rows\n", bytes.size() - pos, STEPS + 1); failures++; }
+    for (size_t r = 0; r < rows; r++) {
+        double point;
+        memcpy(&point, bytes.data() + pos + r * row_bytes, sizeof(point));
+        if (point != 1000.0 + r) { printf("binary: row %zu has point %g\n", r, point); failures++; break; }
+    }
+    printf("binary: %u nodes, %u currents, %zu rows\n", nodes, currents, rows);
+    return failures;
+}
+
+int main() {
+    int failures = 0;
+    const std::pair<sink_format, const char*> formats[] = {{sink_csv, "csv"}, {sink_binary, "binary"}};
+    for (auto& [format, name] : formats) {
+        std::string async = sweep(format, true), sync = sweep(format, false);
+        bool same = !async.empty() && async == sync;
+        printf("%s: %zu bytes, async %s sync\n", name, async.size(), same ? "matches" : "differs from");
+        if (!same) failures++;
+        if (format == sink_binary) failures += check_binary(async);
+        else {
+            size_t lines = 0;
+            for (char ch : async) lines += ch == '\n';
+            if (lines != STEPS + 2) { printf("csv: %zu lines, expected %ld\n", lines, STEPS + 2); failures++; }
+        }
+    }
+
+    /* A full device must be reported by finish() */
+    if (FILE* full = fopen("/dev/full", "wb")) {
+        Circuit c = Circuit::createFromFile("res/example1.cir");
+        ResultSink sink(default_sink_options(full), result_layout(c, "solution"));
+        sink.write(0.0, c.solve());
+        bool ok = sink.finish();
+        printf("/dev/full: finish() %s\n", ok ? "succeeded" : "failed");
+        if (ok) failures++;
+        fclose(full);
+    }
+    return failures == 0 ? 0 : 1;
+}
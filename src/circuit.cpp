@@ -1,56 +1,335 @@
 #include "circuit.hpp"
+#include <ctype.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "subcircuit.hpp"
 
 Circuit::Circuit() {}
 
 Circuit::Circuit(unsigned int nN, unsigned int nV, unsigned int nR, unsigned int nI)
     : nN(nN), nV(nV), nR(nR), nI(nI) {}
 
+static bool sameWord(const char* a, const char* b) {
+	for (; *a && *b; a++, b++) if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return false;
+	return *a == *b;
+}
+
+/* Cut a line into whitespace separated words in place (strtok is not safe across threads) */
+static std::vector<char*> splitWords(char* line) {
+	std::vector<char*> words;
+	for (char* p = line; *p;) {
+		while (*p && isspace((unsigned char)*p)) *p++ = '\0';
+		if (*p) words.push_back(p);
+		while (*p && !isspace((unsigned char)*p)) p++;
+	}
+	return words;
+}
+
+static bool readNode(const char* tok, unsigned int& n) {
+	char* end;
+	unsigned long v = strtoul(tok, &end, 10);
+	n = v;
+	return *end == '\0' && end != tok;
+}
+
+/*
+    Netlist lines are "<name> <node> <node> <value>" for R, V and I, with
+    subcircuits written as
+
+        .subckt NAME port1 port2 ...
+        ...
+        .ends
+        Xname node1 node2 ... NAME
+
+    Blank lines and lines starting with '*' are skipped, ".end" stops reading.
+*/
 Circuit Circuit::createFromFile(const char *filename) {
+	bool success;
+	std::string error;
+	Circuit c = createFromFile(filename, success, error);
+	if (!success) { fprintf(stderr, "%s\n", error.c_str()); exit(EXIT_FAILURE); }
+	return c;
+}
+
+static std::string formatError(const char* format, ...) {
+	char message[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	return message;
+}
+
+Circuit Circuit::createFromFile(const char *filename, bool& success, std::string& error) {
+	PROFILE_SCOPE("circuit.parse");
     Circuit c = Circuit(0, 0, 0, 0);
 	FILE *fPtr;
-	Component p;
-	
+	char line[4096];
+	unsigned int lineNo = 0;
+	success = false;
+
+	/* Definitions, and instances whose definition is looked up once all are read */
+	std::vector<std::shared_ptr<Subcircuit>> defs;
+	std::shared_ptr<Subcircuit> open;
+	struct Use { long owner; size_t index; std::string def; unsigned int line; };
+	std::vector<Use> uses;
+
 	/* Try to open the file */
 	fPtr = fopen(filename, "r");
-	if (!fPtr) { fprintf(stderr, "Could not open file: %s\n", filename); exit(EXIT_FAILURE); }
-
-    unsigned int nC = 0;
+	if (!fPtr) { error = formatError("Could not open file: %s", filename); return c; }
 
-	/* Read the netlist to find out how many components there are and dynamically allocate the memory */
-	while(fscanf(fPtr, "%s %u %u %lf", p.name, &p.n1, &p.n2, &p.value) == 4) nC++; 
+	bool bad = false;
+	while (!bad && fgets(line, sizeof(line), fPtr)) {
+		lineNo++;
+		std::vector<char*> tok = splitWords(line);
+		if (tok.empty() || tok[0][0] == '*') continue;
 
-    c.comp.reserve(nC);
-    c.comp.resize(nC);
+		if (tok[0][0] == '.') {
+			if (sameWord(tok[0], ".subckt") && tok.size() >= 3 && !open) {
+				open = std::make_shared<Subcircuit>();
+				snprintf(open->name, sizeof(open->name), "%s", tok[1]);
+				for (size_t k = 2; k < tok.size(); k++) {
+					unsigned int port;
+					if (!readNode(tok[k], port) || port == 0) bad = true;
+					open->ports.push_back(port);
+				}
+				defs.push_back(open);
+			}
+			else if (sameWord(tok[0], ".ends") && open) open = nullptr;
+			else if (sameWord(tok[0], ".end")) break;
+			else bad = true;
+			continue;
+		}
 
-	/* Do another pass to read in the components */
-	rewind(fPtr);
-		
-	for(nC=0; fscanf(fPtr, "%s %u %u %lf", c.comp[nC].name, &c.comp[nC].n1, &c.comp[nC].n2, &c.comp[nC].value) == 4; nC++) {
+		if (tok[0][0] == 'X') {
+			Instance x;
+			if (tok.size() < 3) { bad = true; continue; }
+			snprintf(x.name, sizeof(x.name), "%s", tok[0]);
+			x.def = 0;
+			x.nodes.resize(tok.size() - 2);
+			for (size_t k = 0; k < x.nodes.size(); k++) if (!readNode(tok[k + 1], x.nodes[k])) bad = true;
+			std::vector<Instance>& list = open ? open->inst : c.inst;
+			uses.push_back({open ? (long)defs.size() - 1 : -1, list.size(), tok.back(), lineNo});
+			list.push_back(std::move(x));
+			continue;
+		}
 
-		switch(c.comp[nC].name[0]) {
-			case 'R': c.nR++; c.comp[nC].type = resistor; break;
-			case 'V': c.nV++; c.comp[nC].type = voltage; break;
-			case 'I': c.nI++; c.comp[nC].type = current; break;
-			default: fprintf(stderr, "Unknown component on line %u in file %s.\n", nC + 1, filename); exit(EXIT_FAILURE);
+		Component cp;
+		char* end;
+		if (tok.size() != 4 || !readNode(tok[1], cp.n1) || !readNode(tok[2], cp.n2)) { bad = true; continue; }
+		cp.value = strtod(tok[3], &end);
+		if (*end != '\0') { bad = true; continue; }
+		snprintf(cp.name, sizeof(cp.name), "%s", tok[0]);
+		switch(cp.name[0]) {
+			case 'R': cp.type = resistor; if (!open) c.nR++; break;
+			case 'V': cp.type = voltage; if (!open) c.nV++; break;
+			case 'I': cp.type = current; if (!open) c.nI++; break;
+			default:
+				fclose(fPtr);
+				error = formatError("Unknown component on line %u in file %s.", lineNo, filename);
+				return c;
 		}
-		if (c.comp[nC].n1 > c.nN) c.nN = c.comp[nC].n1;
-		if (c.comp[nC].n2 > c.nN) c.nN = c.comp[nC].n2;
+		(open ? open->comp : c.comp).push_back(cp);
 	}
 
-	c.nN++; /* Node labelling is zero based so add one to get total number of nodes. */
 	fclose(fPtr);
+	if (bad) { error = formatError("Could not read line %u in file %s.", lineNo, filename); return c; }
+	if (open) { error = formatError("Missing .ends for subcircuit %s in file %s.", open->name, filename); return c; }
+
+	for (auto& u : uses) {
+		Instance& x = u.owner < 0 ? c.inst[u.index] : defs[u.owner]->inst[u.index];
+		auto d = std::find_if(defs.begin(), defs.end(),
+			[&](const std::shared_ptr<Subcircuit>& s) { return u.def == s->name; });
+		if (d == defs.end() || (*d)->portCount() != x.nodes.size()) {
+			error = formatError("No subcircuit %s with %zu ports for line %u in file %s.", u.def.c_str(), x.nodes.size(), u.line, filename);
+			return c;
+		}
+		x.def = d - defs.begin();
+	}
+	/* Each definition is reduced to its macromodel once, however often it is used */
+	for (unsigned int d = 0; d < defs.size(); d++)
+		if (!buildMacromodel(defs, d, error)) return c;
+	c.defs.assign(defs.begin(), defs.end());
+
+	c.compactNodes();
+	c.reorderNodes();
+	success = true;
 	return c;
 }
 
-void Circuit::analyseCircuit() {
+/*
+    Renumber the nodes that are actually used to the dense range [0, nN), so
+    sparse labels such as "V 0 9999 1" do not create empty rows. Ground
+    (label 0) is always id 0. labels[] keeps the original label for reporting.
+*/
+void Circuit::compactNodes() {
+	std::vector<unsigned int> used(1, 0);
+	used.reserve(2 * comp.size() + 1);
+	for (auto& cp : comp) {
+		used.push_back(cp.n1);
+		used.push_back(cp.n2);
+	}
+	for (auto& x : inst) used.insert(used.end(), x.nodes.begin(), x.nodes.end());
+	std::sort(used.begin(), used.end());
+	used.erase(std::unique(used.begin(), used.end()), used.end());
+
+	auto id = [&used](unsigned int label) -> unsigned int { return std::lower_bound(used.begin(), used.end(), label) - used.begin(); };
+	for (auto& cp : comp) {
+		cp.n1 = id(cp.n1);
+		cp.n2 = id(cp.n2);
+	}
+	for (auto& x : inst) for (auto& n : x.nodes) n = id(n);
+	labels = std::move(used);
+	nN = labels.size();
+}
+
+/* Renumber the nodes in reverse Cuthill-McKee order to keep the profile of the system small */
+void Circuit::reorderNodes() {
+	PROFILE_SCOPE("circuit.order");
+	/* An instance couples all of its ports, so order as if they were joined pairwise */
+	std::vector<Component> joins;
+	for (auto& x : inst)
+		for (size_t p = 0; p < x.nodes.size(); p++)
+			for (size_t q = p + 1; q < x.nodes.size(); q++)
+				joins.push_back({"", 1.0, x.nodes[p], x.nodes[q], resistor});
+	std::vector<unsigned int> perm;
+	if (joins.empty()) perm = reverseCuthillMcKee(comp, nN);
+	else {
+		joins.insert(joins.end(), comp.begin(), comp.end());
+		perm = reverseCuthillMcKee(joins, nN);
+	}
+	std::vector<unsigned int> newId(nN), newLabels(nN);
+	for (unsigned int i = 0; i < nN; i++) {
+		newId[perm[i]] = i;
+		newLabels[i] = nodeLabel(perm[i]);
+	}
+	for (auto& cp : comp) {
+		cp.n1 = newId[cp.n1];
+		cp.n2 = newId[cp.n2];
+	}
+	for (auto& x : inst) for (auto& n : x.nodes) n = newId[n];
+	labels = std::move(newLabels);
+}
+
+/*
+    Breadth first search from `root` over nodes not yet placed. Marks visited
+    nodes with `stamp` and returns the number of levels; `last` receives the
+    nodes on the deepest level.
+*/
+static unsigned int bfsLevels(unsigned int root, const std::vector<unsigned int>& start,
+		const std::vector<unsigned int>& adj, const std::vector<char>& placed,
+		std::vector<unsigned int>& mark, unsigned int stamp, std::vector<unsigned int>& last) {
+	std::vector<unsigned int> level(1, root), next;
+	unsigned int depth = 0;
+	mark[root] = stamp;
+	while (!level.empty()) {
+		depth++;
+		next.clear();
+		for (unsigned int u : level)
+			for (unsigned int e = start[u]; e < start[u + 1]; e++) {
+				unsigned int v = adj[e];
+				if (placed[v] || mark[v] == stamp) continue;
+				mark[v] = stamp;
+				next.push_back(v);
+			}
+		if (next.empty()) last = level;
+		level.swap(next);
+	}
+	return depth;
+}
+
+std::vector<unsigned int> reverseCuthillMcKee(const std::vector<Component>& comp, unsigned int nN) {
+	/* Node adjacency in compressed rows. Ground and self loops are left out. */
+	std::vector<unsigned int> start(nN + 1, 0);
+	for (auto& cp : comp)
+		if (cp.type != current && cp.n1 != cp.n2 && cp.n1 && cp.n2) { start[cp.n1 + 1]++; start[cp.n2 + 1]++; }
+	for (unsigned int i = 0; i < nN; i++) start[i + 1] += start[i];
+	std::vector<unsigned int> adj(start[nN]), fill(start.begin(), start.end() - 1);
+	for (auto& cp : comp)
+		if (cp.type != current && cp.n1 != cp.n2 && cp.n1 && cp.n2) {
+			adj[fill[cp.n1]++] = cp.n2;
+			adj[fill[cp.n2]++] = cp.n1;
+		}
+	auto degree = [&](unsigned int u) { return start[u + 1] - start[u]; };
+
+	std::vector<unsigned int> byDegree(nN > 0 ? nN - 1 : 0);
+	std::iota(byDegree.begin(), byDegree.end(), 1);
+	std::stable_sort(byDegree.begin(), byDegree.end(),
+		[&](unsigned int a, unsigned int b) { return degree(a) < degree(b); });
+
+	std::vector<char> placed(nN, 0);
+	std::vector<unsigned int> mark(nN, 0), order, last, nbrs;
+	unsigned int stamp = 0;
+	order.reserve(nN);
+	if (nN) placed[0] = 1;
+
+	for (unsigned int seed : byDegree) {
+		if (placed[seed]) continue;
+
+		/* Walk to a pseudo-peripheral node: keep moving to the lowest degree
+		   node of the deepest level while that makes the level structure deeper */
+		unsigned int root = seed, depth = bfsLevels(root, start, adj, placed, mark, ++stamp, last);
+		for (int tries = 0; tries < 8; tries++) {
+			unsigned int cand = *std::min_element(last.begin(), last.end(),
+				[&](unsigned int a, unsigned int b) { return degree(a) < degree(b); });
+			std::vector<unsigned int> candLast;
+			unsigned int d = bfsLevels(cand, start, adj, placed, mark, ++stamp, candLast);
+			if (d <= depth) break;
+			root = cand;
+			depth = d;
+			last.swap(candLast);
+		}
+
+		/* Cuthill-McKee: breadth first, neighbours in increasing degree */
+		size_t head = order.size();
+		order.push_back(root);
+		placed[root] = 1;
+		while (head < order.size()) {
+			unsigned int u = order[head++];
+			nbrs.clear();
+			for (unsigned int e = start[u]; e < start[u + 1]; e++)
+				if (!placed[adj[e]]) { placed[adj[e]] = 1; nbrs.push_back(adj[e]); }
+			std::stable_sort(nbrs.begin(), nbrs.end(),
+				[&](unsigned int a, unsigned int b) { return degree(a) < degree(b); });
+			order.insert(order.end(), nbrs.begin(), nbrs.end());
+		}
+	}
+
+	std::vector<unsigned int> perm;
+	perm.reserve(nN);
+	if (nN) perm.push_back(0);
+	perm.insert(perm.end(), order.rbegin(), order.rend());
+	return perm;
+}
+
+/*
+    Fill in the modified nodal analysis equations A X = Z. A is returned as a
+    list of (row, col, value) terms; repeated positions add up.
+*/
+void Circuit::buildSystem(std::vector<MatrixEntry>& A, Vector& Z) {
+	PROFILE_SCOPE("circuit.assemble");
     unsigned int n1, n2, i, cV;
 	double value, g;
 	
-	/* Initialise matrices and vectors and zero elements */
-	Matrix A(0.0, nN + nV, nN + nV);
-	Vector Z(0.0, nN + nV), X(0.0, nN + nV);
+	/* Initialise the term list */
+	A.clear();
+	size_t terms = 4 * comp.size() + 1;
+	for (auto& x : inst) terms += x.nodes.size() * x.nodes.size();
+	A.reserve(terms);
+
+	/* Node 0 is ground and is treated differently: its row and column hold a single 1 */
+	auto stamp = [&A](unsigned int r, unsigned int c, double v) {
+		if (r != 0 && c != 0) A.push_back({r, c, v});
+	};
+	A.push_back({0, 0, 1.0});
 
 	/* Build nodal analysis equations */
 	for(i=0, cV=0; i<comp.size(); i++) {
@@ -60,72 +339,639 @@ void Circuit::analyseCircuit() {
 		switch(comp[i].type) {
 			case resistor: 
 				g = 1.0/value;
-                A(n1, n2) -= g;
-				A(n2, n1) -= g;
-				A(n1, n1) += g;
-				A(n2, n2) += g;	
+				stamp(n1, n2, -g);
+				stamp(n2, n1, -g);
+				stamp(n1, n1, g);
+				stamp(n2, n2, g);
 			break;
 			case voltage: 
-				A(n1, cV + nN) = A(cV + nN, n1) = 1.0;                
-				A(n2, cV + nN) = A(cV + nN, n2) = -1.0;
-				Z[cV + nN] = -value;
+				stamp(n1, cV + nN, 1.0);
+				stamp(cV + nN, n1, 1.0);
+				stamp(n2, cV + nN, -1.0);
+				stamp(cV + nN, n2, -1.0);
 				cV++;
 			break;
-			case current: 
-				Z[n1] -= value;
-				Z[n2] += value;
+			case current: break;
+		}
+	}
+
+	/* Each instance adds the macromodel of its definition over its ports */
+	for (auto& x : inst) {
+		const Subcircuit& d = *defs[x.def];
+		size_t P = d.portCount();
+		for (size_t p = 0; p < P; p++)
+			for (size_t q = 0; q < P; q++) stamp(x.nodes[p], x.nodes[q], d.G[p * P + q]);
+	}
+	buildRhs(Z);
+}
+
+/* Right hand side of the system alone; only the sources contribute */
+void Circuit::buildRhs(Vector& Z) {
+	unsigned int i, cV;
+	Z = Vector(0.0, nN + nV);
+	for(i=0, cV=0; i<comp.size(); i++) {
+		switch(comp[i].type) {
+			case resistor: break;
+			case voltage: Z[nN + cV++] = -comp[i].value; break;
+			case current:
+				Z[comp[i].n1] -= comp[i].value;
+				Z[comp[i].n2] += comp[i].value;
 			break;
 		}
 	}
-	
-	/* Node 0 is ground and is treated differently */
-	A(0, 0) = 1.0; 
+	for (auto& x : inst)
+		for (size_t p = 0; p < x.nodes.size(); p++) Z[x.nodes[p]] += defs[x.def]->J[p];
 	Z[0] = 0.0;
-	for(i=1; i<nN + nV; i++) 
-		A(0, i) = A(i, 0) = 0.0;
+}
+
+/* Disjoint set forest with path halving and union by size */
+struct NodeSets {
+	std::vector<unsigned int> parent, size;
+
+	NodeSets(unsigned int n): parent(n), size(n, 1) { std::iota(parent.begin(), parent.end(), 0); }
+	unsigned int find(unsigned int a) {
+		while (parent[a] != a) a = parent[a] = parent[parent[a]];
+		return a;
+	}
+	void unite(unsigned int a, unsigned int b) {
+		a = find(a); b = find(b);
+		if (a == b) return;
+		if (size[a] < size[b]) std::swap(a, b);
+		parent[b] = a;
+		size[a] += size[b];
+	}
+};
+
+/* A connected piece of the circuit with its own ground, solved on its own */
+struct Circuit::Island {
+	Circuit circuit;
+	std::vector<unsigned int> nodes;   // local id - 1 -> node id in the parent
+	std::vector<unsigned int> sources; // local voltage source -> parent voltage source
+	bool grounded;
+};
+
+/*
+    Split the circuit into pieces that only share ground. Ground is fixed at
+    0 V, so pieces that meet only there are independent systems. Resistors
+    and voltage sources join nodes; current sources only inject current, so
+    each end is given to its own island with ground as the other terminal.
+
+    A piece with no resistor or voltage source to ground is floating: its
+    voltages are not determined and it is reported instead of solved.
+    Components with both ends on one node are reported and left out.
+*/
+std::vector<Circuit::Island> Circuit::splitIslands(CircuitSolution& sol) {
+	PROFILE_SCOPE("circuit.islands");
+	NodeSets sets(nN);
+	std::vector<char> touchesGround(nN, 0);
+	for (unsigned int i = 0; i < comp.size(); i++) {
+		Component& cp = comp[i];
+		if (cp.n1 == cp.n2) { sol.selfLoops.push_back(i); continue; }
+		if (cp.type == current) continue;
+		if (cp.n1 && cp.n2) sets.unite(cp.n1, cp.n2);
+		else touchesGround[cp.n1 + cp.n2] = 1;
+	}
+	/* An instance is taken to join all its ports, and to ground if its definition reaches it */
+	for (auto& x : inst) {
+		auto first = std::find_if(x.nodes.begin(), x.nodes.end(), [](unsigned int n) { return n != 0; });
+		if (first == x.nodes.end()) continue;
+		for (unsigned int n : x.nodes) if (n) sets.unite(*first, n);
+		if (defs[x.def]->grounded || std::count(x.nodes.begin(), x.nodes.end(), 0u)) touchesGround[*first] = 1;
+	}
+
+	std::vector<unsigned int> islandOf(nN, 0), local(nN, 0);
+	std::vector<Island> islands;
+	std::vector<unsigned int> islandOfRoot(nN, UINT32_MAX);
+	for (unsigned int n = 1; n < nN; n++) {
+		unsigned int root = sets.find(n);
+		if (islandOfRoot[root] == UINT32_MAX) {
+			islandOfRoot[root] = islands.size();
+			islands.push_back({Circuit(1, 0, 0, 0), {}, {}, false});
+		}
+		Island& isl = islands[islandOfRoot[root]];
+		islandOf[n] = islandOfRoot[root];
+		isl.nodes.push_back(n);
+		local[n] = isl.nodes.size();
+		isl.grounded = isl.grounded || touchesGround[n];
+	}
+
+	/* Node ids are already in profile reducing order, and islands keep it */
+	for (auto& isl : islands) {
+		isl.circuit.defs = defs;
+		isl.circuit.nN = isl.nodes.size() + 1;
+		isl.circuit.labels.resize(isl.circuit.nN, 0);
+		for (unsigned int k = 0; k < isl.nodes.size(); k++)
+			isl.circuit.labels[k + 1] = nodeLabel(isl.nodes[k]);
+	}
+
+	unsigned int cV = 0;
+	for (unsigned int i = 0; i < comp.size(); i++) {
+		Component cp = comp[i];
+		unsigned int source = cV;
+		if (cp.type == voltage) cV++;
+		if (cp.n1 == cp.n2) continue;
+
+		if (cp.type == current && cp.n1 && cp.n2 && islandOf[cp.n1] != islandOf[cp.n2]) {
+			Component half = cp;
+			half.n1 = local[cp.n1]; half.n2 = 0;
+			islands[islandOf[cp.n1]].circuit.comp.push_back(half);
+			islands[islandOf[cp.n1]].circuit.nI++;
+			half.n1 = 0; half.n2 = local[cp.n2];
+			islands[islandOf[cp.n2]].circuit.comp.push_back(half);
+			islands[islandOf[cp.n2]].circuit.nI++;
+			continue;
+		}
+
+		Island& isl = islands[islandOf[cp.n1 ? cp.n1 : cp.n2]];
+		cp.n1 = local[cp.n1];
+		cp.n2 = local[cp.n2];
+		isl.circuit.comp.push_back(cp);
+		switch (cp.type) {
+			case resistor: isl.circuit.nR++; break;
+			case voltage: isl.circuit.nV++; isl.sources.push_back(source); break;
+			case current: isl.circuit.nI++; break;
+		}
+	}
+	for (auto& x : inst) {
+		auto first = std::find_if(x.nodes.begin(), x.nodes.end(), [](unsigned int n) { return n != 0; });
+		if (first == x.nodes.end()) continue;
+		Instance y = x;
+		for (auto& n : y.nodes) n = local[n];
+		islands[islandOf[*first]].circuit.inst.push_back(std::move(y));
+	}
+	return islands;
+}
+
+/* Voltage of an eliminated node: V[node] = V[a] + ratio * (V[b] - V[a]) */
+struct Elimination {
+	unsigned int node, a, b;
+	double ratio;
+};
+
+/* A smaller circuit with the same voltages and source currents at its nodes */
+struct Circuit::Reduction {
+	Circuit circuit;                // labels[] hold node ids of the original
+	std::vector<Elimination> steps; // in elimination order
+
+	/* Node voltages of the original circuit from the solution of the reduced one */
+	std::vector<double> expand(const Vector& X, unsigned int nN) {
+		std::vector<double> v(nN, 0.0);
+		for (unsigned int k = 1; k < circuit.nN; k++) v[circuit.labels[k]] = X[k];
+		for (auto it = steps.rbegin(); it != steps.rend(); ++it)
+			v[it->node] = v[it->a] + it->ratio * (v[it->b] - v[it->a]);
+		return v;
+	}
+};
+
+/*
+    Shrink the resistor network before assembly. Parallel resistors are
+    merged, a node joined to exactly two resistors is removed by putting them
+    in series, and a node on a single resistor carries no current and takes
+    the voltage of its neighbour. Ground and nodes touching a source are
+    kept, so source currents are unchanged. Removing a node can expose its
+    neighbours, so they are revisited until nothing changes.
+*/
+Circuit::Reduction Circuit::reduceTopology() {
+	PROFILE_SCOPE("circuit.reduce");
+	struct Edge { unsigned int a, b; double r; bool alive; };
+	std::vector<Edge> edges;
+	std::vector<std::vector<unsigned int>> incident(nN);
+	std::vector<unsigned int> degree(nN, 0);
+	std::vector<char> keep(nN, 0), removed(nN, 0);
+
+	/* Add a resistor, or merge it into one already joining the same nodes */
+	auto connect = [&](unsigned int a, unsigned int b, double r) {
+		unsigned int shorter = incident[a].size() < incident[b].size() ? a : b;
+		for (unsigned int e : incident[shorter]) {
+			Edge& x = edges[e];
+			if (x.alive && x.a + x.b == a + b && (x.a == a || x.a == b)) {
+				x.r = x.r * r / (x.r + r);
+				return false;
+			}
+		}
+		incident[a].push_back(edges.size());
+		incident[b].push_back(edges.size());
+		edges.push_back({a, b, r, true});
+		degree[a]++;
+		degree[b]++;
+		return true;
+	};
+	auto disconnect = [&](unsigned int e) {
+		edges[e].alive = false;
+		degree[edges[e].a]--;
+		degree[edges[e].b]--;
+	};
+
+	if (nN) keep[0] = 1;
+	for (auto& x : inst) for (unsigned int n : x.nodes) keep[n] = 1;
+	for (auto& cp : comp) {
+		if (cp.type != resistor) { keep[cp.n1] = keep[cp.n2] = 1; continue; }
+		if (cp.n1 != cp.n2) connect(cp.n1, cp.n2, cp.value);
+	}
+
+	Reduction red;
+	std::vector<unsigned int> work, live;
+	for (unsigned int n = nN; n-- > 1;) if (!keep[n] && degree[n] <= 2) work.push_back(n);
+	while (!work.empty()) {
+		unsigned int n = work.back();
+		work.pop_back();
+		if (keep[n] || removed[n] || degree[n] == 0 || degree[n] > 2) continue;
+
+		/* Drop dead entries so the incidence list stays short */
+		live.clear();
+		for (unsigned int e : incident[n]) if (edges[e].alive) live.push_back(e);
+		incident[n] = live;
+
+		Edge e1 = edges[live[0]];
+		unsigned int a = e1.a == n ? e1.b : e1.a;
+		removed[n] = 1;
+		disconnect(live[0]);
+		if (live.size() == 1) {
+			red.steps.push_back({n, a, a, 0.0});
+			work.push_back(a);
+			continue;
+		}
+		Edge e2 = edges[live[1]];
+		unsigned int b = e2.a == n ? e2.b : e2.a;
+		disconnect(live[1]);
+		red.steps.push_back({n, a, b, e1.r / (e1.r + e2.r)});
+		if (!connect(a, b, e1.r + e2.r)) { work.push_back(a); work.push_back(b); }
+	}
+
+	/* Sources keep their netlist order so their currents map straight back */
+	Circuit& c = red.circuit;
+	std::vector<unsigned int> newId(nN, 0);
+	c.nN = 0; c.nV = nV; c.nR = 0; c.nI = nI;
+	for (unsigned int n = 0; n < nN; n++) {
+		if (removed[n]) continue;
+		newId[n] = c.nN++;
+		c.labels.push_back(n);
+	}
+	for (auto& cp : comp) {
+		if (cp.type == resistor) continue;
+		Component s = cp;
+		s.n1 = newId[cp.n1];
+		s.n2 = newId[cp.n2];
+		c.comp.push_back(s);
+	}
+	for (auto& e : edges) {
+		if (!e.alive) continue;
+		Component r = {"R", e.r, newId[e.a], newId[e.b], resistor};
+		c.comp.push_back(r);
+		c.nR++;
+	}
+	c.defs = defs;
+	c.inst = inst;
+	for (auto& x : c.inst) for (auto& n : x.nodes) n = newId[n];
+	if (!red.steps.empty()) c.reorderNodes();
+	return red;
+}
+
+/*
+    Solve every grounded island as its own system, in parallel, and collect
+    the results by node id of this circuit.
+*/
+CircuitSolution Circuit::solve() {
+	PROFILE_SCOPE("circuit.solve");
+	CircuitSolution sol;
+	sol.voltage.assign(nN, NAN);
+	sol.current.assign(nV, NAN);
+	sol.floating.assign(nN, 0);
+	if (nN) sol.voltage[0] = 0.0;
+
+	std::vector<Island> islands = splitIslands(sol);
+	sol.islands = islands.size();
+
+	std::vector<Island*> grounded;
+	for (auto& isl : islands) {
+		if (isl.grounded) { grounded.push_back(&isl); continue; }
+		sol.floatingIslands.push_back(isl.nodes);
+		for (unsigned int n : isl.nodes) sol.floating[n] = 1;
+	}
+	/* Biggest first so one large island does not finish last on its own */
+	std::sort(grounded.begin(), grounded.end(),
+		[](Island* a, Island* b) { return a->circuit.comp.size() > b->circuit.comp.size(); });
+
+	std::atomic<unsigned int> reduced = 0;
+	parallel_for_each(grounded.size(), 0, [&](size_t k) {
+		Island& isl = *grounded[k];
+		Reduction red = isl.circuit.reduceTopology();
+		Circuit& c = red.circuit;
+		std::vector<MatrixEntry> A;
+		Vector Z;
+		c.buildSystem(A, Z);
+		Vector X = LUFactor(c.systemSize(), A).solve(Z);
+		std::vector<double> v = red.expand(X, isl.circuit.nN);
+		reduced += c.systemSize();
+
+		/* Islands own disjoint nodes and sources, so these writes never overlap */
+		for (unsigned int n = 0; n < isl.nodes.size(); n++) sol.voltage[isl.nodes[n]] = v[n + 1];
+		for (unsigned int s = 0; s < isl.sources.size(); s++) sol.current[isl.sources[s]] = X[c.nN + s];
+	});
+	sol.reducedUnknowns = reduced;
+	return sol;
+}
+
+/*
+    True when every node has a path to ground through resistors, voltage
+    sources or instances and no voltage source is shorted, i.e. the whole system can be
+    factored at once without the island handling of solve().
+*/
+static bool regularSystem(const std::vector<Component>& comp, const std::vector<Instance>& inst,
+		const std::vector<std::shared_ptr<const Subcircuit>>& defs, unsigned int nN) {
+	NodeSets sets(nN);
+	for (auto& cp : comp) {
+		if (cp.n1 == cp.n2) { if (cp.type == voltage) return false; continue; }
+		if (cp.type != current) sets.unite(cp.n1, cp.n2);
+	}
+	for (auto& x : inst) {
+		for (unsigned int n : x.nodes) sets.unite(x.nodes[0], n);
+		if (defs[x.def]->grounded) sets.unite(x.nodes[0], 0);
+	}
+	for (unsigned int n = 1; n < nN; n++) if (sets.find(n) != sets.find(0)) return false;
+	return true;
+}
+
+/* Factor the whole system as it is now and drop pending updates */
+bool Circuit::factorAll() {
+	factored.ends.clear();
+	factored.dg.clear();
+	factored.W.clear();
+	factored.valid = regularSystem(comp, inst, defs, nN);
+	if (factored.valid) {
+		std::vector<MatrixEntry> A;
+		Vector Z;
+		buildSystem(A, Z);
+		factored.lu = LUFactor(systemSize(), A);
+	}
+	return factored.valid;
+}
+
+/* Record a change of dg in the conductance between n1 and n2, before it is made */
+void Circuit::conductanceChanged(unsigned int n1, unsigned int n2, double dg) {
+	if (n1 == n2) return;
+	if (n1 > n2) std::swap(n1, n2);
+	if (!factored.valid && !factorAll()) return;
 
-	// printMatrix(A);
-	// printVector(Z);
+	/* Edits of the same branch share one update */
+	for (size_t k = 0; k < factored.ends.size(); k++)
+		if (factored.ends[k][0] == n1 && factored.ends[k][1] == n2) { factored.dg[k] += dg; return; }
+
+	if (factored.ends.size() >= MAX_RANK_UPDATES && !factorAll()) return;
+	Vector u(0.0, systemSize());
+	if (n1) u[n1] = 1.0;
+	u[n2] = -1.0;
+	factored.W.push_back(factored.lu.solve(u));
+	factored.ends.push_back({n1, n2});
+	factored.dg.push_back(dg);
+}
+
+/*
+    With k pending updates A' = A + U D U^T, and by Sherman-Morrison-Woodbury
+    A'^-1 Z = y - W (I + D U^T W)^-1 D U^T y with y = A^-1 Z and W = A^-1 U.
+    That is one solve with the cached factors plus a k by k system. If the
+    small system is close to singular the edits have made the circuit
+    degenerate, so everything is solved again from scratch.
+*/
+CircuitSolution Circuit::resolve() {
+	PROFILE_SCOPE("circuit.resolve");
+	if (!factored.valid || !regularSystem(comp, inst, defs, nN)) {
+		factored.valid = false;
+		return solve();
+	}
+
+	Vector Z;
+	buildRhs(Z);
+	Vector x = factored.lu.solve(Z);
+	size_t k = factored.W.size();
+	if (k) {
+		auto ut = [this](size_t i, const Vector& v) {
+			return (factored.ends[i][0] ? v[factored.ends[i][0]] : 0.0) - v[factored.ends[i][1]];
+		};
+		std::vector<double> T(k * k), z(k);
+		for (size_t i = 0; i < k; i++) {
+			z[i] = factored.dg[i] * ut(i, x);
+			for (size_t j = 0; j < k; j++) T[i * k + j] = (i == j) + factored.dg[i] * ut(i, factored.W[j]);
+		}
+
+		/* Gaussian elimination with partial pivoting on the k by k system */
+		double largest = 0.0, smallest = INFINITY;
+		for (size_t c = 0; c < k; c++) {
+			size_t p = c;
+			for (size_t r = c + 1; r < k; r++) if (fabs(T[r * k + c]) > fabs(T[p * k + c])) p = r;
+			if (p != c) {
+				std::swap_ranges(&T[c * k], &T[c * k] + k, &T[p * k]);
+				std::swap(z[c], z[p]);
+			}
+			double pivot = T[c * k + c];
+			largest = std::max(largest, fabs(pivot));
+			smallest = std::min(smallest, fabs(pivot));
+			if (!std::isfinite(pivot) || smallest <= 1e-12 * largest) {
+				factored.valid = false;
+				return solve();
+			}
+			for (size_t r = c + 1; r < k; r++) {
+				double f = T[r * k + c] / pivot;
+				for (size_t j = c; j < k; j++) T[r * k + j] -= f * T[c * k + j];
+				z[r] -= f * z[c];
+			}
+		}
+		for (size_t c = k; c-- > 0;) {
+			for (size_t j = c + 1; j < k; j++) z[c] -= T[c * k + j] * z[j];
+			z[c] /= T[c * k + c];
+		}
+		for (size_t j = 0; j < k; j++) x -= z[j] * factored.W[j];
+	}
+
+	CircuitSolution sol;
+	sol.voltage.assign(std::begin(x), std::begin(x) + nN);
+	sol.current.assign(std::begin(x) + nN, std::end(x));
+	sol.floating.assign(nN, 0);
+	sol.islands = 1;
+	for (unsigned int i = 0; i < comp.size(); i++) if (comp[i].n1 == comp[i].n2) sol.selfLoops.push_back(i);
+	sol.reducedUnknowns = systemSize();
+	return sol;
+}
+
+int Circuit::findComponent(const char* name) {
+	for (size_t i = 0; i < comp.size(); i++)
+		if (!strcmp(comp[i].name, name)) return i;
+	return -1;
+}
+
+/* Node id of a netlist label; a new label becomes a new node */
+unsigned int Circuit::nodeId(unsigned int label) {
+	for (unsigned int id = 0; id < labels.size(); id++)
+		if (labels[id] == label) return id;
+	labels.push_back(label);
+	nN = labels.size();
+	factored.valid = false;
+	return nN - 1;
+}
+
+bool Circuit::setValue(const char* name, double value) {
+	int i = findComponent(name);
+	if (i < 0) return false;
+	if (comp[i].type == resistor) conductanceChanged(comp[i].n1, comp[i].n2, 1.0/value - 1.0/comp[i].value);
+	comp[i].value = value;
+	return true;
+}
+
+void Circuit::addComponent(const char* name, unsigned int n1, unsigned int n2, double value) {
+	Component cp;
+	snprintf(cp.name, sizeof(cp.name), "%s", name);
+	cp.value = value;
+	cp.n1 = nodeId(n1);
+	cp.n2 = nodeId(n2);
+	switch(name[0]) {
+		case 'R': nR++; cp.type = resistor; conductanceChanged(cp.n1, cp.n2, 1.0/value); break;
+		case 'V': nV++; cp.type = voltage; factored.valid = false; break;
+		case 'I': nI++; cp.type = current; break;
+		default: fprintf(stderr, "Unknown component: %s\n", name); exit(EXIT_FAILURE);
+	}
+	comp.push_back(cp);
+}
+
+bool Circuit::removeComponent(const char* name) {
+	int i = findComponent(name);
+	if (i < 0) return false;
+	switch(comp[i].type) {
+		case resistor: nR--; conductanceChanged(comp[i].n1, comp[i].n2, -1.0/comp[i].value); break;
+		case voltage: nV--; factored.valid = false; break;
+		case current: nI--; break;
+	}
+	comp.erase(comp.begin() + i);
+	return true;
+}
+
+void Circuit::analyseCircuit(FILE* out) {
+    unsigned int i, cV;
+	CircuitSolution sol = resolve();
 
 	/* Analyse and display results */
-	X = solveLinearSystem(A, Z);
-	printf("----------------------------\n");
-	printf(" Voltage sources: %u\n", nV);
-	printf(" Current sources: %u\n", nI);
-	printf("       Resistors: %u\n", nR);
-	printf("           Nodes: %u\n", nN);
-	printf("----------------------------\n");
-	for(i=0; i<nN; i++)
-		printf(" Node %3u = %10.6lf V\n", i, X[i]);
-	printf("----------------------------\n");
+	fprintf(out, "----------------------------\n");
+	fprintf(out, " Voltage sources: %u\n", nV);
+	fprintf(out, " Current sources: %u\n", nI);
+	fprintf(out, "       Resistors: %u\n", nR);
+	fprintf(out, "           Nodes: %u\n", nN);
+	if (!inst.empty()) fprintf(out, "     Subcircuits: %zu (%zu instances)\n", defs.size(), inst.size());
+	fprintf(out, "----------------------------\n");
+	if (sol.islands > 1 || !sol.floatingIslands.empty() || !sol.selfLoops.empty()) {
+		fprintf(out, "         Islands: %u (%zu floating)\n", sol.islands, sol.floatingIslands.size());
+		for (auto& isl : sol.floatingIslands) {
+			std::vector<unsigned int> names;
+			for (unsigned int n : isl) names.push_back(nodeLabel(n));
+			std::sort(names.begin(), names.end());
+			fprintf(out, " Floating island:");
+			for (size_t k = 0; k < names.size() && k < 8; k++) fprintf(out, " %u", names[k]);
+			if (names.size() > 8) fprintf(out, " ... (%zu nodes)", names.size());
+			fprintf(out, "\n");
+		}
+		/* Voltage sources in a floating island are left unsolved with it */
+		std::vector<const char*> unsolved;
+		for (auto& cp : comp)
+			if (cp.type == voltage && (sol.floating[cp.n1] || sol.floating[cp.n2])) unsolved.push_back(cp.name);
+		if (!unsolved.empty()) {
+			fprintf(out, "Unsolved sources: %zu in floating islands:", unsolved.size());
+			for (size_t k = 0; k < unsolved.size() && k < 8; k++) fprintf(out, " %s", unsolved[k]);
+			if (unsolved.size() > 8) fprintf(out, " ...");
+			fprintf(out, "\n");
+		}
+		if (!sol.selfLoops.empty()) {
+			fprintf(out, "      Self loops: %zu ignored:", sol.selfLoops.size());
+			for (size_t k = 0; k < sol.selfLoops.size() && k < 8; k++) fprintf(out, " %s", comp[sol.selfLoops[k]].name);
+			if (sol.selfLoops.size() > 8) fprintf(out, " ...");
+			fprintf(out, "\n");
+		}
+		fprintf(out, "----------------------------\n");
+	}
+	/* Report nodes in the order of their original labels */
+	std::vector<unsigned int> byLabel(nN);
+	std::iota(byLabel.begin(), byLabel.end(), 0);
+	std::sort(byLabel.begin(), byLabel.end(),
+		[this](unsigned int a, unsigned int b) { return nodeLabel(a) < nodeLabel(b); });
+	for (unsigned int id : byLabel) {
+		if (sol.floating[id]) fprintf(out, " Node %3u =   floating\n", nodeLabel(id));
+		else fprintf(out, " Node %3u = %10.6lf V\n", nodeLabel(id), sol.voltage[id]);
+	}
+	fprintf(out, "----------------------------\n");
+	/* Internal nodes of every instance, nested ones depth first, named by their path */
+	std::vector<std::pair<std::string, const Instance*>> pending;
+	for (size_t k = inst.size(); k-- > 0;) pending.push_back({inst[k].name, &inst[k]});
+	while (!pending.empty()) {
+		auto [path, x] = pending.back();
+		pending.pop_back();
+		std::vector<unsigned int> nodes;
+		std::vector<double> voltage;
+		internalVoltages(path.c_str(), sol, nodes, voltage);
+		for (size_t k = 0; k < nodes.size(); k++) {
+			if (std::isnan(voltage[k])) fprintf(out, " Node %s.%u =   floating\n", path.c_str(), nodes[k]);
+			else fprintf(out, " Node %s.%u = %10.6lf V\n", path.c_str(), nodes[k], voltage[k]);
+		}
+		const std::vector<Instance>& inner = defs[x->def]->inst;
+		for (size_t k = inner.size(); k-- > 0;) pending.push_back({path + "." + inner[k].name, &inner[k]});
+	}
+	if (!inst.empty()) fprintf(out, "----------------------------\n");
 	if (nV) {
 		for(i=0, cV=0; i<comp.size(); i++)
-			if (comp[i].type == voltage)
-				printf(" I(%s)    = %10.6lf A\n", comp[i].name, X[nN + cV++]);
-		printf("----------------------------\n");
+			if (comp[i].type == voltage) {
+				double I = sol.current[cV++];
+				if (std::isnan(I)) fprintf(out, " I(%s)    =   floating\n", comp[i].name);
+				else fprintf(out, " I(%s)    = %10.6lf A\n", comp[i].name, I);
+			}
+		fprintf(out, "----------------------------\n");
+	}
+}
+
+Component Circuit::component(unsigned int i) { return comp[i]; }
+unsigned int Circuit::nodeCount() { return nN; }
+unsigned int Circuit::componentCount() { return comp.size(); }
+unsigned int Circuit::systemSize() { return nN + nV; }
+unsigned int Circuit::nodeLabel(unsigned int id) { return id < labels.size() ? labels[id] : id; }
+
+bool Circuit::internalVoltages(const char* instance, const CircuitSolution& sol,
+		std::vector<unsigned int>& nodes, std::vector<double>& voltage) {
+	std::string path(instance);
+	size_t dot = path.find('.');
+	auto named = [&](const std::vector<Instance>& list) {
+		std::string name = path.substr(0, dot);
+		return std::find_if(list.begin(), list.end(), [&](const Instance& x) { return name == x.name; });
+	};
+
+	auto x = named(inst);
+	if (x == inst.end()) return false;
+	std::vector<double> port;
+	for (unsigned int n : x->nodes) port.push_back(sol.voltage[n]);
+	const Subcircuit* d = defs[x->def].get();
+
+	/* Walk down the path, recovering each level from the ports of the one below it */
+	for (;;) {
+		std::vector<double> xi = d->recover(port);
+		if (dot == std::string::npos) {
+			nodes = d->internal;
+			voltage.assign(xi.begin(), xi.begin() + d->internal.size());
+			return true;
+		}
+		path.erase(0, dot + 1);
+		dot = path.find('.');
+		auto y = named(d->inst);
+		if (y == d->inst.end()) return false;
+
+		std::vector<double> next;
+		for (unsigned int label : y->nodes) {
+			auto p = std::find(d->ports.begin(), d->ports.end(), label);
+			auto i = std::find(d->internal.begin(), d->internal.end(), label);
+			if (label == 0) next.push_back(0.0);
+			else if (p != d->ports.end()) next.push_back(port[p - d->ports.begin()]);
+			else next.push_back(xi[i - d->internal.begin()]);
+		}
+		port.swap(next);
+		d = defs[y->def].get();
 	}
 }
 
 Vector solveLinearSystem(Matrix A, Vector b)
 {
-	/* Note: This function overwrites the contents of A and b. */
-	int i, j, k;
-	double mult, sum;
-	Vector x(0.0, A.col_size());
-
-	/* reduce to upper triangular form */
-	for (i=0; i<A.row_size()-1; i++)
-		for (j=i+1; j<A.row_size(); j++) {   
-			mult = -A(j, i)/A(i, i);
-			for (k=i; k<A.col_size(); k++)
-				A(j, k) += mult*A(i, k);
-			b[j] += mult*b[i];
-		}
-	/* back substitute to find Vector x */
-	for (i=A.row_size()-1; i>=0; i--) {
-		for (j=i+1, sum = 0.0; j<A.col_size(); j++)
-			sum += A(i, j) * x[j];
-		x[i] = (b[i] - sum)/A(i, i);
-	}
-	return x;
-}
\ No newline at end of file
+	PROFILE_SCOPE("circuit.solve_linear_system");
+	return LUFactor(A).solve(b);
+}
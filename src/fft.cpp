@@ -0,0 +1,514 @@
+#include "fft.hpp"
+#include "profile.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
+// Butterflies handled together by the vectorized kernels
+static const size_t FFT_LANES = 8;
+
+static inline void cmul(double& re, double& im, double wr, double wi) {
+    double t = re * wr - im * wi;
+    im = re * wi + im * wr;
+    re = t;
+}
+
+/*
+    Radix R butterflies on L consecutive inputs. x points at input j, read
+    at multiples of `stride` (n / R); y at output (j / span) * span * R +
+    j % span, written at multiples of `span`; w at the stage twiddles for
+    t = j % span, read at multiples of `span` for r = 1..R-1. Lane runs are
+    only taken when span >= L, so the outputs of different lanes never
+    overlap; ivdep tells the compiler so and the lane loop vectorizes.
+*/
+struct Radix2 {
+    static const size_t R = 2;
+    template <size_t L>
+    static void run(const double* __restrict xr, const double* __restrict xi, size_t stride,
+                    double* __restrict yr, double* __restrict yi, size_t span,
+                    const double* __restrict wr, const double* __restrict wi) {
+#pragma GCC ivdep
+        for (size_t l = 0; l < L; l++) {
+            double a0r = xr[l], a0i = xi[l];
+            double a1r = xr[stride + l], a1i = xi[stride + l];
+            cmul(a1r, a1i, wr[l], wi[l]);
+            yr[l] = a0r + a1r;
+            yi[l] = a0i + a1i;
+            yr[span + l] = a0r - a1r;
+            yi[span + l] = a0i - a1i;
+        }
+    }
+};
+
+struct Radix3 {
+    static const size_t R = 3;
+    template <size_t L>
+    static void run(const double* __restrict xr, const double* __restrict xi, size_t stride,
+                    double* __restrict yr, double* __restrict yi, size_t span,
+                    const double* __restrict wr, const double* __restrict wi) {
+        const double S = 0.86602540378443864676; // sin(2 pi / 3)
+#pragma GCC ivdep
+        for (size_t l = 0; l < L; l++) {
+            double a0r = xr[l], a0i = xi[l];
+            double a1r = xr[stride + l], a1i = xi[stride + l];
+            double a2r = xr[2 * stride + l], a2i = xi[2 * stride + l];
+            cmul(a1r, a1i, wr[l], wi[l]);
+            cmul(a2r, a2i, wr[span + l], wi[span + l]);
+            double t1r = a1r + a2r, t1i = a1i + a2i;
+            double t2r = a0r - 0.5 * t1r, t2i = a0i - 0.5 * t1i;
+            // -i S (a1 - a2)
+            double t3r = S * (a1i - a2i), t3i = -S * (a1r - a2r);
+            yr[l] = a0r + t1r;
+            yi[l] = a0i + t1i;
+            yr[span + l] = t2r + t3r;
+            yi[span + l] = t2i + t3i;
+            yr[2 * span + l] = t2r - t3r;
+            yi[2 * span + l] = t2i - t3i;
+        }
+    }
+};
+
+struct Radix4 {
+    static const size_t R = 4;
+    template <size_t L>
+    static void run(const double* __restrict xr, const double* __restrict xi, size_t stride,
+                    double* __restrict yr, double* __restrict yi, size_t span,
+                    const double* __restrict wr, const double* __restrict wi) {
+#pragma GCC ivdep
+        for (size_t l = 0; l < L; l++) {
+            double a0r = xr[l], a0i = xi[l];
+            double a1r = xr[stride + l], a1i = xi[stride + l];
+            double a2r = xr[2 * stride + l], a2i = xi[2 * stride + l];
+            double a3r = xr[3 * stride + l], a3i = xi[3 * stride + l];
+            cmul(a1r, a1i, wr[l], wi[l]);
+            cmul(a2r, a2i, wr[span + l], wi[span + l]);
+            cmul(a3r, a3i, wr[2 * span + l], wi[2 * span + l]);
+            double t0r = a0r + a2r, t0i = a0i + a2i;
+            double t1r = a0r - a2r, t1i = a0i - a2i;
+            double t2r = a1r + a3r, t2i = a1i + a3i;
+            // -i (a1 - a3)
+            double t3r = a1i - a3i, t3i = a3r - a1r;
+            yr[l] = t0r + t2r;
+            yi[l] = t0i + t2i;
+            yr[span + l] = t1r + t3r;
+            yi[span + l] = t1i + t3i;
+            yr[2 * span + l] = t0r - t2r;
+            yi[2 * span + l] = t0i - t2i;
+            yr[3 * span + l] = t1r - t3r;
+            yi[3 * span + l] = t1i - t3i;
+        }
+    }
+};
+
+struct Radix5 {
+    static const size_t R = 5;
+    template <size_t L>
+    static void run(const double* __restrict xr, const double* __restrict xi, size_t stride,
+                    double* __restrict yr, double* __restrict yi, size_t span,
+                    const double* __restrict wr, const double* __restrict wi) {
+        const double C1 = 0.30901699437494742410;  // cos(2 pi / 5)
+        const double C2 = -0.80901699437494742410; // cos(4 pi / 5)
+        const double S1 = 0.95105651629515357212;  // sin(2 pi / 5)
+        const double S2 = 0.58778525229247312917;  // sin(4 pi / 5)
+#pragma GCC ivdep
+        for (size_t l = 0; l < L; l++) {
+            double a0r = xr[l], a0i = xi[l];
+            double a1r = xr[stride + l], a1i = xi[stride + l];
+            double a2r = xr[2 * stride + l], a2i = xi[2 * stride + l];
+            double a3r = xr[3 * stride + l], a3i = xi[3 * stride + l];
+            double a4r = xr[4 * stride + l], a4i = xi[4 * stride + l];
+            cmul(a1r, a1i, wr[l], wi[l]);
+            cmul(a2r, a2i, wr[span + l], wi[span + l]);
+            cmul(a3r, a3i, wr[2 * span + l], wi[2 * span + l]);
+            cmul(a4r, a4i, wr[3 * span + l], wi[3 * span + l]);
+            double b1r = a1r + a4r, b1i = a1i + a4i, d1r = a1r - a4r, d1i = a1i - a4i;
+            double b2r = a2r + a3r, b2i = a2i + a3i, d2r = a2r - a3r, d2i = a2i - a3i;
+            double m1r = a0r + C1 * b1r + C2 * b2r, m1i = a0i + C1 * b1i + C2 * b2i;
+            double m2r = a0r + C2 * b1r + C1 * b2r, m2i = a0i + C2 * b1i + C1 * b2i;
+            double n1r = S1 * d1r + S2 * d2r, n1i = S1 * d1i + S2 * d2i;
+            double n2r = S2 * d1r - S1 * d2r, n2i = S2 * d1i - S1 * d2i;
+            // y1 = m1 - i n1, y4 = m1 + i n1, y2 = m2 - i n2, y3 = m2 + i n2
+            yr[l] = a0r + b1r + b2r;
+            yi[l] = a0i + b1i + b2i;
+            yr[span + l] = m1r + n1i;
+            yi[span + l] = m1i - n1r;
+            yr[4 * span + l] = m1r - n1i;
+            yi[4 * span + l] = m1i + n1r;
+            yr[2 * span + l] = m2r + n2i;
+            yi[2 * span + l] = m2i - n2r;
+            yr[3 * span + l] = m2r - n2i;
+            yi[3 * span + l] = m2i + n2r;
+        }
+    }
+};
+
+/*
+    One Stockham stage: input j = b * span + t goes to output
+    b * span * R + t. Runs of FFT_LANES values of t go through the lane
+    kernels; the first stages (span < FFT_LANES) run one butterfly at a time.
+*/
+template <typename Radix>
+static void stage(const double* ir, const double* ii, double* outr, double* outi,
+                  size_t n, size_t span, const double* wr, const double* wi) {
+    const size_t R = Radix::R, stride = n / R;
+    for (size_t b = 0; b < n / (R * span); b++) {
+        const double* xr = ir + b * span;
+        const double* xi = ii + b * span;
+        double* yr = outr + b * span * R;
+        double* yi = outi + b * span * R;
+        size_t t = 0;
+        for (; t + FFT_LANES <= span; t += FFT_LANES)
+            Radix::template run<FFT_LANES>(xr + t, xi + t, stride, yr + t, yi + t, span, wr + t, wi + t);
+        for (; t < span; t++)
+            Radix::template run<1>(xr + t, xi + t, stride, yr + t, yi + t, span, wr + t, wi + t);
+    }
+}
+
+FftPlan::FftPlan(size_t n): n(n) {
+    PROFILE_SCOPE("fft.plan");
+    size_t m = n;
+    if (m > 1) {
+        while (m % 4 == 0) { radices.push_back(4); m /= 4; }
+        while (m % 2 == 0) { radices.push_back(2); m /= 2; }
+        while (m % 3 == 0) { radices.push_back(3); m /= 3; }
+        while (m % 5 == 0) { radices.push_back(5); m /= 5; }
+    }
+
+    if (m > 1) {
+        /* Bluestein: x_k w_k convolved with conj(w), w_k = e^(-i pi k^2 / n) */
+        radices.clear();
+        size_t len = 1;
+        while (len < 2 * n - 1) len <<= 1;
+        inner = fft_plan(len);
+        chirp_re.resize(n);
+        chirp_im.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            double angle = PI * (double)((unsigned long long)k * k % (2 * n)) / n;
+            chirp_re[k] = cos(angle);
+            chirp_im[k] = -sin(angle);
+        }
+        kernel_re.assign(len, 0.0);
+        kernel_im.assign(len, 0.0);
+        for (size_t k = 0; k < n; k++) {
+            kernel_re[k] = chirp_re[k];
+            kernel_im[k] = -chirp_im[k];
+            if (k) {
+                kernel_re[len - k] = chirp_re[k];
+                kernel_im[len - k] = -chirp_im[k];
+            }
+        }
+        inner->forward(kernel_re.data(), kernel_im.data());
+        return;
+    }
+
+    size_t span = 1;
+    for (size_t R : radices) {
+        std::vector<double> wr((R - 1) * span), wi((R - 1) * span);
+        for (size_t r = 1; r < R; r++)
+            for (size_t t = 0; t < span; t++) {
+                double angle = -2.0 * PI * (double)(r * t % (span * R)) / (double)(span * R);
+                wr[(r - 1) * span + t] = cos(angle);
+                wi[(r - 1) * span + t] = sin(angle);
+            }
+        tw_re.push_back(std::move(wr));
+        tw_im.push_back(std::move(wi));
+        span *= R;
+    }
+}
+
+size_t FftPlan::size() const { return n; }
+
+void FftPlan::stockham(double* re, double* im) const {
+    thread_local std::vector<double> scratch_re, scratch_im;
+    if (scratch_re.size() < n) {
+        scratch_re.resize(n);
+        scratch_im.resize(n);
+    }
+    double *sr = re, *si = im, *dr = scratch_re.data(), *di = scratch_im.data();
+    size_t span = 1;
+    for (size_t s = 0; s < radices.size(); s++) {
+        const double* wr = tw_re[s].data();
+        const double* wi = tw_im[s].data();
+        switch (radices[s]) {
+            case 2: stage<Radix2>(sr, si, dr, di, n, span, wr, wi); break;
+            case 3: stage<Radix3>(sr, si, dr, di, n, span, wr, wi); break;
+            case 4: stage<Radix4>(sr, si, dr, di, n, span, wr, wi); break;
+            case 5: stage<Radix5>(sr, si, dr, di, n, span, wr, wi); break;
+        }
+        std::swap(sr, dr);
+        std::swap(si, di);
+        span *= radices[s];
+    }
+    if (sr != re) {
+        memcpy(re, sr, n * sizeof(double));
+        memcpy(im, si, n * sizeof(double));
+    }
+}
+
+void FftPlan::bluestein(double* re, double* im) const {
+    const size_t len = inner->size();
+    std::vector<double> ar(len, 0.0), ai(len, 0.0);
+    for (size_t k = 0; k < n; k++) {
+        ar[k] = re[k];
+        ai[k] = im[k];
+        cmul(ar[k], ai[k], chirp_re[k], chirp_im[k]);
+    }
+    inner->forward(ar.data(), ai.data());
+    for (size_t k = 0; k < len; k++) cmul(ar[k], ai[k], kernel_re[k], kernel_im[k]);
+    inner->inverse(ar.data(), ai.data());
+    for (size_t k = 0; k < n; k++) {
+        cmul(ar[k], ai[k], chirp_re[k], chirp_im[k]);
+        re[k] = ar[k] / len;
+        im[k] = ai[k] / len;
+    }
+}
+
+void FftPlan::forward(double* re, double* im) const {
+    PROFILE_SCOPE("fft.forward");
+    if (inner) bluestein(re, im);
+    else stockham(re, im);
+}
+
+// conj(F(conj(x)))
+void FftPlan::inverse(double* re, double* im) const {
+    for (size_t k = 0; k < n; k++) im[k] = -im[k];
+    forward(re, im);
+    for (size_t k = 0; k < n; k++) im[k] = -im[k];
+}
+
+RealFftPlan::RealFftPlan(size_t n): n(n) {
+    if (n < 2 || n % 2) {
+        half = fft_plan(n);
+        return;
+    }
+    half = fft_plan(n / 2);
+    tw_re.resize(n / 2 + 1);
+    tw_im.resize(n / 2 + 1);
+    for (size_t k = 0; k <= n / 2; k++) {
+        tw_re[k] = cos(2.0 * PI * k / n);
+        tw_im[k] = -sin(2.0 * PI * k / n);
+    }
+}
+
+size_t RealFftPlan::size() const { return n; }
+
+/*
+    Even sizes pack x[2j] + i x[2j+1] into half as many complex points, then
+    split the result into the even and odd sample spectra E and O:
+    X[k] = E[k] + e^(-2 pi i k / n) O[k].
+*/
+void RealFftPlan::forward(const double* x, double* re, double* im) const {
+    if (tw_re.empty()) {
+        std::vector<double> zr(x, x + n), zi(n, 0.0);
+        half->forward(zr.data(), zi.data());
+        for (size_t k = 0; k <= n / 2 && k < n; k++) { re[k] = zr[k]; im[k] = zi[k]; }
+        return;
+    }
+    const size_t m = n / 2;
+    thread_local std::vector<double> zr, zi;
+    if (zr.size() < m) {
+        zr.resize(m);
+        zi.resize(m);
+    }
+    for (size_t j = 0; j < m; j++) {
+        zr[j] = x[2 * j];
+        zi[j] = x[2 * j + 1];
+    }
+    half->forward(zr.data(), zi.data());
+    for (size_t k = 0; k <= m; k++) {
+        size_t a = k < m ? k : 0, b = k ? m - k : 0;
+        double er = 0.5 * (zr[a] + zr[b]), ei = 0.5 * (zi[a] - zi[b]);
+        // (Z[a] - conj(Z[b])) / 2i
+        double orr = 0.5 * (zi[a] + zi[b]), oi = -0.5 * (zr[a] - zr[b]);
+        cmul(orr, oi, tw_re[k], tw_im[k]);
+        re[k] = er + orr;
+        im[k] = ei + oi;
+    }
+}
+
+/* Built outside the lock since Bluestein plans ask for their inner plan */
+template <typename Plan>
+static std::shared_ptr<const Plan> cached_plan(size_t n) {
+    static std::mutex lock;
+    static std::unordered_map<size_t, std::shared_ptr<const Plan>> plans;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = plans.find(n);
+        if (it != plans.end()) return it->second;
+    }
+    auto plan = std::make_shared<const Plan>(n);
+    std::lock_guard<std::mutex> guard(lock);
+    return plans.emplace(n, plan).first->second;
+}
+
+std::shared_ptr<const FftPlan> fft_plan(size_t n) { return cached_plan<FftPlan>(n); }
+std::shared_ptr<const RealFftPlan> real_fft_plan(size_t n) { return cached_plan<RealFftPlan>(n); }
+
+bool parse_window(const char* name, fft_window& window) {
+    static const char* names[] = {"rect", "hann", "hamming", "blackman"};
+    for (int i = 0; i < 4; i++)
+        if (!strcmp(name, names[i])) { window = (fft_window)i; return true; }
+    return false;
+}
+
+/* Periodic windows, which suit DFT analysis; returns the coherent gain. The
+   rectangular window is left empty so the samples are transformed as they are. */
+static double make_window(fft_window type, size_t n, std::vector<double>& w) {
+    w.clear();
+    if (type == window_rect || n == 0) return 1.0;
+    w.resize(n);
+    double sum = 0.0;
+    for (size_t j = 0; j < n; j++) {
+        double phase = 2.0 * PI * j / n;
+        switch (type) {
+            case window_rect: break;
+            case window_hann: w[j] = 0.5 - 0.5 * cos(phase); break;
+            case window_hamming: w[j] = 0.54 - 0.46 * cos(phase); break;
+            case window_blackman: w[j] = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase); break;
+        }
+        sum += w[j];
+    }
+    return sum / n;
+}
+
+static FourierSeries analyse(const double* x, size_t n, const std::vector<double>& window, double gain,
+                             double dx, size_t harmonics, size_t periods, double x0) {
+    PROFILE_SCOPE("fft.coefficients");
+    FourierSeries series;
+    series.f0 = n ? 360.0 * periods / (n * dx) : 0.0;
+    series.cos_coefs.assign(harmonics, 0.0);
+    series.sin_coefs.assign(harmonics, 0.0);
+    if (n == 0) return series;
+
+    std::vector<double> buffer, re(n / 2 + 1), im(n / 2 + 1);
+    if (!window.empty()) {
+        buffer.resize(n);
+        for (size_t j = 0; j < n; j++) buffer[j] = x[j] * window[j];
+        x = buffer.data();
+    }
+    real_fft_plan(n)->forward(x, re.data(), im.data());
+
+    double scale = 1.0 / (n * gain);
+    for (size_t k = 0; k < harmonics; k++) {
+        size_t bin = k * periods;
+        if (bin > n / 2) break;
+        // The DC and Nyquist bins carry the whole amplitude, the others half
+        bool edge = bin == 0 || (n % 2 == 0 && bin == n / 2);
+        double a = (edge ? 1.0 : 2.0) * re[bin] * scale;
+        double b = edge ? 0.0 : -2.0 * im[bin] * scale;
+        /* Refer the phase to x = 0 rather than to the first sample */
+        if (x0 != 0.0) {
+            double theta = k * series.f0 * x0 * PI / 180.0;
+            double c = cos(theta), s = sin(theta);
+            double rotated = a * c - b * s;
+            b = a * s + b * c;
+            a = rotated;
+        }
+        series.cos_coefs[k] = a;
+        series.sin_coefs[k] = b;
+    }
+    return series;
+}
+
+/*
+    Samples of the leading floor(periods) whole periods of n samples that
+    span `periods` periods, so each harmonic lands on an FFT bin. Less than
+    one period is taken as exactly one.
+*/
+static size_t whole_periods(size_t n, double periods, size_t& whole) {
+    if (!(periods > 1.0)) { whole = 1; return n; }
+    whole = (size_t)periods;
+    return std::min(n, (size_t)llround(n * (whole / periods)));
+}
+
+FourierSeries fourier_coefficients(std::span<const double> samples, double dx, size_t harmonics,
+                                   double periods, fft_window window, double x0) {
+    size_t whole;
+    size_t n = whole_periods(samples.size(), periods, whole);
+    std::vector<double> w;
+    double gain = make_window(window, n, w);
+    return analyse(samples.data(), n, w, gain, dx, harmonics, whole, x0);
+}
+
+FourierPlotter to_plotter(const FourierSeries& series) {
+    FourierPlotter p(series.cos_coefs.size(), series.f0);
+    for (double c : series.cos_coefs) p.append_cos_coef(c);
+    for (double s : series.sin_coefs) p.append_sin_coef(s);
+    return p;
+}
+
+BlockAnalyzer::BlockAnalyzer(size_t block, size_t hop, size_t harmonics, double periods, fft_window window,
+                             double dx, double x0, std::function<void(size_t, const FourierSeries&)> on_block):
+    block(block ? block : 1), hop(hop ? hop : this->block), harmonics(harmonics), dx(dx), x0(x0),
+    head(0), skip(0), position(0), blocks(0), on_block(on_block) {
+    used = whole_periods(this->block, periods, this->periods);
+    gain = make_window(window, used, this->window);
+}
+
+void BlockAnalyzer::push(std::span<const double> samples) {
+    pending.insert(pending.end(), samples.begin(), samples.end());
+    while (true) {
+        size_t drop = std::min(skip, pending.size() - head);
+        head += drop;
+        position += drop;
+        skip -= drop;
+        if (skip || pending.size() - head < block) break;
+
+        on_block(position, analyse(pending.data() + head, used, window, gain, dx, harmonics, periods, x0 + position * dx));
+        blocks++;
+        size_t step = std::min(hop, block);
+        head += step;
+        position += step;
+        skip = hop - step;
+    }
+    /* Keep the buffer from growing with the stream */
+    if (head > 0 && head >= pending.size() / 2) {
+        pending.erase(pending.begin(), pending.begin() + head);
+        head = 0;
+    }
+}
+
+size_t BlockAnalyzer::get_blocks() { return blocks; }
+
+bool read_waveform(const char* filename, std::vector<double>& samples, double& dx, double& x0) {
+    FILE* f = fopen(filename, "r");
+    if (!f) { fprintf(stderr, "Could not open file: %s\n", filename); return false; }
+    samples.clear();
+    std::vector<double> xs;
+    char line[512];
+    unsigned int n = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        n++;
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') continue;
+
+        char* end;
+        double first = strtod(p, &end);
+        ok = end != p;
+        p = end;
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (ok && *p != '\0' && *p != '\n' && *p != '\r') {
+            double second = strtod(p, &end);
+            ok = end != p;
+            p = end;
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+            ok = ok && *p == '\0';
+            xs.push_back(first);
+            samples.push_back(second);
+        } else samples.push_back(first);
+        ok = ok && (xs.empty() || xs.size() == samples.size());
+    }
+    fclose(f);
+    if (!ok) { fprintf(stderr, "Could not read line %u in file %s.\n", n, filename); return false; }
+    if (samples.empty()) { fprintf(stderr, "No samples in file %s.\n", filename); return false; }
+
+    x0 = xs.empty() ? 0.0 : xs.front();
+    dx = xs.size() >= 2 ? (xs.back() - xs.front()) / (xs.size() - 1) : 1.0;
+    return true;
+}
@@ -1,166 +1,105 @@
 #include <stdlib.h>
+#include <bit>
 #include <cstdio>
-#include <ctype.h>
 #include <fstream>
-#include <sstream>
 #include <string_view>
 #include "logic.hpp"
+#include "profile.hpp"
 
-/*
-    Parses an parametric boolean algebra expression.
-
-    The syntax is specified below:
-
-    ```ebnf
-    [a-z] <spaces> = <spaces> ([A-Z]'? <spaces>)+ (<plus> <spaces> ([A-Z]'? <spaces>)+)*
-    ```
+static bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+static bool is_upper(char c) { return c >= 'A' && c <= 'Z'; }
 
-    For example, `x = A B' + CD + S'` is valid.
+/*
+    Parses the equation starting at `cur`, appending its nodes to `arena`.
+    On failure `cur` is left on the offending character.
 */
-ParseResult parse2(std::string_view& str) {
-    size_t cur = 0;
-    char func;
-    ParseResult res;
-    parse_status err;
-    std::vector<Node> stack;
-    CharBitSet vars(0);
-    bool eof = false;
-    bool valid = false;
-    while (true) {
-        if (!islower(str[0])) { err = expect_binding; break; }
-        func = str[0];
-        err = expect_equal;
-        str = str.substr(1); // skip <binding name>
-        if (eof = !skip_while(str, ' ')) break;
-        if (str[0] != '=') break;
-        str = str.substr(1); // skip `=`
-        err = expect_var;
-        if (eof = !skip_while(str, ' ')) break;
+static parse_status parse_equation(const char* str, size_t len, size_t& cur,
+                                   std::vector<Node>& arena, char& binding, CharBitSet& vars) {
+    auto skip_blank = [&]() { while (cur < len && (str[cur] == ' ' || str[cur] == '\t' || str[cur] == '\r')) cur++; };
+    auto at_end = [&]() { return cur >= len || str[cur] == '\n'; };
+
+    if (!is_lower(str[cur])) return expect_binding;
+    binding = str[cur++];
+    skip_blank();
+    if (at_end() || str[cur] != '=') return expect_equal;
+    cur++;
+    skip_blank();
 
-        while (true) {
-            if (!isupper(str[0])) { break; }
-            vars.set(str[0]);
-            stack.push_back({val, str[0], false});
-            str = str.substr(1); // skip <var name>
-            valid = true;
-            if (str.length() > 0 && str[0] == '\'') { stack.back().inv = true; str = str.substr(1); } // skip `'`
-            if (eof = !skip_while(str, ' ')) break;
-            if (str[0] == '+') { stack.push_back({op_and, '\0', false}); valid = false; str = str.substr(1); } // skip `+`
-            if (eof = !skip_while(str, ' ')) break;
-        }
-        break;
+    while (true) {
+        if (at_end()) return unexpected_eof;
+        if (!is_upper(str[cur])) return expect_var;
+        // One product: variables with an optional `'`
+        do {
+            char name = str[cur++];
+            bool inv = cur < len && str[cur] == '\'';
+            cur += inv;
+            arena.push_back({val, name, inv});
+            vars.set(name);
+            skip_blank();
+        } while (!at_end() && is_upper(str[cur]));
+
+        if (at_end()) { arena.push_back({op_or, '\0', false}); return parse_ok; }
+        if (str[cur] != '+') return expect_var;
+        arena.push_back({op_and, '\0', false});
+        cur++;
+        skip_blank();
     }
-    res = err;
-    if (eof && valid) { stack.push_back({op_or, '\0', false}); res = Equation(func, stack, vars); }
-    return res;
 }
 
-bool skip_while(std::string_view& str, char char_to_skip) {
-    size_t cur = 0;
-    bool in_eqn = false;
-    while (in_eqn = (cur < str.length() && str[cur] != '\n')) {
-        // printf("cur = %u, c = %c\n", cur, str[cur]);
-        if (str[cur] == char_to_skip) cur++;
-        else { cur = cur == 0 ? 0 : cur--; break; }
-    }
-    str = str.substr(cur);
-    return in_eqn;
+struct EquationExtent {
+    char binding;
+    size_t offset;
+    size_t length;
+    CharBitSet vars;
+};
+
+/* Equations are rebuilt from offsets once the arena stops moving */
+static void point_into(std::vector<Equation>& eqns, const std::vector<EquationExtent>& extents, const Node* base) {
+    eqns.clear();
+    eqns.reserve(extents.size());
+    for (auto& e : extents) eqns.emplace_back(e.binding, std::span<const Node>(base + e.offset, e.length), e.vars);
 }
 
-ParseResult parse(const char* str, size_t& cur, std::size_t len) {
-    parse_state s = S0;
-    parse_status err;
-    char func;
-    bool skip_space = false;
-    bool may_end = false;
-    bool reject = false;
-    bool seen_newline = false;
-    std::vector<Node> stack;
-    CharBitSet vars(0);
+static std::vector<EquationExtent> extents_of(const std::vector<Equation>& eqns, const Node* base) {
+    std::vector<EquationExtent> extents;
+    extents.reserve(eqns.size());
+    for (Equation eqn : eqns)
+        extents.push_back({eqn.get_binding(), (size_t)(eqn.get_nodes().data() - base), eqn.get_nodes().size(), eqn.get_vars()});
+    return extents;
+}
 
-    ParseResult res;
+void LogicFile::parse(std::string_view text) {
+    std::vector<EquationExtent> extents = extents_of(eqns, arena.data());
+    const char* str = text.data();
+    size_t len = text.size(), cur = 0;
+    arena.reserve(arena.size() + len / 2);
 
     while (true) {
-        if (reject) { break; }
-        if (seen_newline) break;
-        if (cur >= len || str[cur] == '\n') { 
-            if (may_end) stack.push_back({op_or, '\0', false});
-        }
+        while (cur < len && (str[cur] == '\n' || str[cur] == ' ' || str[cur] == '\t' || str[cur] == '\r')) cur++;
         if (cur >= len) break;
-        if (str[cur] == '\n') { cur++; seen_newline = true; }
-        if (skip_space) { 
-            while(str[cur] == ' ') {
-                cur++;
-                if (cur >= len) break;
-            }
-            skip_space = false;
+
+        size_t start = arena.size();
+        char binding;
+        CharBitSet vars(0);
+        parse_status status = parse_equation(str, len, cur, arena, binding, vars);
+        if (status == parse_ok) {
+            extents.push_back({binding, start, arena.size() - start, vars});
+            continue;
         }
-        // printf("State: S%d; Input: ", s);
-        // str[cur] == ' ' 
-        // ? printf("' '") 
-        // : (str[cur] == '\n' 
-        //     ? printf("'\\n'") 
-        //     : printf("'%c'", str[cur]));
-        // printf("\n");
-        switch (s) {
-            case S0: {
-                if (islower(str[cur])) {
-                    func = str[cur];
-                    s = S1;
-                    cur++;
-                    skip_space = true;
-                } else { err = expect_binding; reject = true; }
-                break;
-            }
-            case S1: {
-                if (str[cur] == '=') { cur++; s = S2; skip_space = true; }
-                else { err = expect_equal; reject = true; }
-                break;
-            }
-            case S2: {
-                if (isupper(str[cur])) { 
-                    stack.push_back({val, str[cur], false});
-                    vars.set(str[cur]);
-                    cur++; 
-                    s = S3;
-                    may_end = true;
-                } else { err = expect_var; reject = true; }
-                break;
-            }
-            case S3: {
-                if (str[cur] == '\'') {
-                    stack.back().inv = true;
-                    may_end = true;
-                    cur++;
-                }
-                s = S4;
-                skip_space = true;
-                break;
-            }
-            case S4: {
-                if (str[cur] == '+') {
-                    stack.push_back({op_and, '\0', false});
-                    cur++;
-                    may_end = false;
-                    skip_space = true;
-                    s = S2;
-                }
-                else if (isupper(str[cur])) {
-                    may_end = true; 
-                    s = S2;
-                }
-                break;                
-            }
+        switch (status) {
+            case expect_binding: fprintf(stderr, "Expected a binding (lower case letter) at %zu", cur); break;
+            case expect_equal: fprintf(stderr, "Expected an equal '=' at %zu", cur); break;
+            case expect_var: fprintf(stderr, "Expected a variable (upper case letter) at %zu", cur); break;
+            case unexpected_eof: fprintf(stderr, "Unexpected Eof"); break;
+            default: break;
         }
+        fprintf(stderr, "\n");
+        // Drop the partial equation and carry on with the next line
+        arena.resize(start);
+        skipped++;
+        while (cur < len && str[cur] != '\n') cur++;
     }
-
-    if (reject) {
-        res = err;
-        cur++;
-    } else if (may_end) {
-        res = Equation(func, stack, vars);
-    } else { res = unexpected_eof; }
-    return res;
+    point_into(eqns, extents, arena.data());
 }
 
 CharBitSet::CharBitSet() {}
@@ -186,21 +125,20 @@ bool CharBitSet::contains(char a) {
 }
 
 
-Equation::Equation() {}
-Equation::Equation(char binding, std::vector<Node> nodes, CharBitSet vars)
+Equation::Equation(): binding('\0'), vars(0) {}
+Equation::Equation(char binding, std::span<const Node> nodes, CharBitSet vars)
     : binding(binding), nodes(nodes), vars(vars) {}
 
 char Equation::get_binding() { return binding; }
 CharBitSet Equation::get_vars() { return vars; }
 
-std::span<Node> Equation::get_nodes() { return std::span(nodes.begin(), nodes.size()); }
+std::span<const Node> Equation::get_nodes() { return nodes; }
 
 bool Equation::evaluate(std::span<bool, 26> map) {
-    std::vector<bool> stack;
+    PROFILE_SCOPE("logic.equation_evaluate");
     bool res = 0;
     bool term = 1;
-    for (size_t i = 0; i < nodes.size(); i++) {
-        Node node = nodes[i];
+    for (const Node& node : nodes) {
         switch (node.type) {
             case val: term = term && (map[node.name - 'A'] != node.inv); break;
             case op_and:
@@ -215,15 +153,39 @@ bool Equation::evaluate(std::span<bool, 26> map) {
     return res;
 }
 
-void print_stack(std::span<Node> stack) {
+void print_stack(std::span<const Node> stack) {
     for (auto node : stack) {
         if (node.type == val) printf("[%s%c]\n", node.inv ? "~" : "", node.name);
         else { printf("[%s]\n", node.type ? "and" : "or"); }
     }
 }
 
-std::vector<Equation> parse_file(const char* filename, bool& success) {
-    std::ifstream logicfile(filename);
+LogicFile::LogicFile() {}
+
+LogicFile::LogicFile(const LogicFile& other): arena(other.arena), skipped(other.skipped) {
+    point_into(eqns, extents_of(other.eqns, other.arena.data()), arena.data());
+}
+
+LogicFile& LogicFile::operator=(const LogicFile& other) {
+    if (this != &other) {
+        arena = other.arena;
+        skipped = other.skipped;
+        point_into(eqns, extents_of(other.eqns, other.arena.data()), arena.data());
+    }
+    return *this;
+}
+
+Equation* LogicFile::begin() { return eqns.data(); }
+Equation* LogicFile::end() { return eqns.data() + eqns.size(); }
+Equation* LogicFile::data() { return eqns.data(); }
+size_t LogicFile::size() { return eqns.size(); }
+bool LogicFile::empty() { return eqns.empty(); }
+Equation& LogicFile::operator[](size_t i) { return eqns[i]; }
+size_t LogicFile::get_skipped() { return skipped; }
+
+LogicFile parse_file(const char* filename, bool& success) {
+    PROFILE_SCOPE("logic.parse_file");
+    std::ifstream logicfile(filename, std::ios::binary);
     if (!logicfile.is_open()) { success = false; return {}; }
     success = true;
     logicfile.seekg(0, std::ios::end);
@@ -232,34 +194,16 @@ std::vector<Equation> parse_file(const char* filename, bool& success) {
     logicfile.seekg(0);
     logicfile.read(&buffer[0], size);
 
-    std::vector<Equation> eqns;
-
-    size_t cur = 0;
-    
-    while (cur < size) {
-        ParseResult res = parse(buffer.c_str(), cur, size);
-        if (Equation* eqn = std::get_if<Equation>(&res)) eqns.push_back(*eqn);
-        else {
-            parse_status status = std::get<parse_status>(res);
-            switch (status) {
-                case expect_binding: printf("Expected a binding (lower case letter) at %d", cur); break;
-                case expect_equal: printf("Expected an equal '=' at %d", cur); break;
-                case expect_var: printf("Expected a variable (upper case letter) at %d", cur); break;
-                case unexpected_eof: printf("Unexpected Eof"); break;
-            }
-            printf("\n");
-        }
-        while (cur < size && (buffer[cur] == '\n' || buffer[cur] == ' ')) { cur++; }
-        if (cur >= size) break;
-    }
-
-    return eqns;
+    LogicFile file;
+    file.parse(buffer);
+    PROFILE_COUNT("logic.bytes_parsed", size);
+    return file;
 }
 
 /* Helper methods */
 CharBitSet combine_vars(std::span<Equation> eqns) {
     CharBitSet out(0);
-    for (auto eqn : eqns) out = out + eqn.get_vars();
+    for (auto& eqn : eqns) out = out + eqn.get_vars();
     return out;
 }
 
@@ -272,7 +216,7 @@ int search_binding(std::span<Equation> eqns, char binding) {
 
 /* Print an equation in this textual format */
 void print_equation_pretty(Equation& eqn) {
-    std::span<Node> nodes = eqn.get_nodes();
+    std::span<const Node> nodes = eqn.get_nodes();
     printf("%c = ", eqn.get_binding());
     for (size_t i = 0; i < nodes.size(); i++) {
         Node node = nodes[i];
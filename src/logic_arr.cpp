@@ -1,10 +1,12 @@
 #include <logic_arr.hpp>
+#include <profile.hpp>
 #include <fstream>
 #include <span>
 
 LogicMap::LogicMap(): and_nodes(0), or_nodes(0) {}
 
 LogicMap LogicMap::create_from_file(const char* filename, bool& success) {
+    PROFILE_SCOPE("logic.map_create_from_file");
     success = false;
     LogicMap map;
     std::ifstream logicfile(filename);
@@ -34,6 +36,7 @@ LogicMap LogicMap::create_from_file(const char* filename, bool& success) {
 
 // 
 bool LogicMap::evaluate(std::span<bool> values, size_t output_idx) {
+    PROFILE_SCOPE("logic.map_evaluate");
     if (output_idx >= num_outputs) return false;
     size_t row_start = num_products * output_idx;
     std::span<uint8_t> row(
@@ -69,6 +72,12 @@ bool LogicMap::evaluate(std::span<bool> values, size_t output_idx) {
     return res == 1;
 }
 
+size_t LogicMap::get_num_inputs() { return num_inputs; }
+size_t LogicMap::get_num_outputs() { return num_outputs; }
+size_t LogicMap::get_num_products() { return num_products; }
+std::span<const uint8_t> LogicMap::get_and_nodes() { return and_nodes; }
+std::span<const uint8_t> LogicMap::get_or_nodes() { return or_nodes; }
+
 void LogicMap::print_map() {
     printf("I: %u O: %u P: %u\n", num_inputs, num_outputs, num_products);
     printf("or_nodes.size() = %u\nand_nodes.size() = %u\n", or_nodes.size(), and_nodes.size());
@@ -0,0 +1,149 @@
+#include "logic_gen.hpp"
+#include <ctype.h>
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+struct ProductLiteral {
+    size_t input;
+    bool inv;
+};
+
+/* Sum of products form shared by both design types */
+struct SumOfProducts {
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::vector<std::vector<ProductLiteral>> products; // an empty product is constant 0
+    std::vector<std::vector<size_t>> uses;             // products summed by each output
+};
+
+/* Every used product is a local so outputs sharing a product compute it once */
+static void write_products(const SumOfProducts& d, const std::vector<bool>& used, FILE* out) {
+    for (size_t p = 0; p < d.products.size(); p++) {
+        if (!used[p]) continue;
+        fprintf(out, "    const std::uint64_t p%zu = ", p);
+        if (d.products[p].empty()) fprintf(out, "0");
+        for (size_t k = 0; k < d.products[p].size(); k++) {
+            const ProductLiteral& l = d.products[p][k];
+            fprintf(out, "%s%s%s", k ? " & " : "", l.inv ? "~" : "", d.inputs[l.input].c_str());
+        }
+        fprintf(out, ";\n");
+    }
+}
+
+static void write_sum(const SumOfProducts& d, size_t o, FILE* out) {
+    if (d.uses[o].empty()) fprintf(out, "0");
+    for (size_t k = 0; k < d.uses[o].size(); k++) fprintf(out, "%sp%zu", k ? " | " : "", d.uses[o][k]);
+}
+
+static void write_design(const SumOfProducts& d, const char* name, const char* source, FILE* out) {
+    size_t ni = d.inputs.size(), no = d.outputs.size();
+    std::vector<bool> used(d.products.size(), false), read(ni, false);
+    for (auto& sum : d.uses)
+        for (size_t p : sum) {
+            used[p] = true;
+            for (auto& l : d.products[p]) read[l.input] = true;
+        }
+
+    fprintf(out, "// Generated by logicgen from %s. Do not edit.\n", source);
+    fprintf(out, "#pragma once\n\n#include <cstdint>\n\nnamespace %s {\n\n", name);
+    fprintf(out, "constexpr unsigned int num_inputs = %zu;\n", ni);
+    fprintf(out, "constexpr unsigned int num_outputs = %zu;\n", no);
+    fprintf(out, "constexpr const char* input_names[] = {");
+    for (size_t i = 0; i < ni; i++) fprintf(out, "%s\"%s\"", i ? ", " : "", d.inputs[i].c_str());
+    fprintf(out, "%s};\n", ni ? "" : "nullptr");
+    fprintf(out, "constexpr const char* output_names[] = {");
+    for (size_t o = 0; o < no; o++) fprintf(out, "%s\"%s\"", o ? ", " : "", d.outputs[o].c_str());
+    fprintf(out, "%s};\n\n", no ? "" : "nullptr");
+
+    fprintf(out, "// in[i] holds input i of 64 vectors, out[o] receives output o of the same vectors\n");
+    fprintf(out, "constexpr void evaluate_sliced(const std::uint64_t* in, std::uint64_t* out) {\n");
+    for (size_t i = 0; i < ni; i++)
+        if (read[i]) fprintf(out, "    const std::uint64_t %s = in[%zu];\n", d.inputs[i].c_str(), i);
+    write_products(d, used, out);
+    for (size_t o = 0; o < no; o++) {
+        fprintf(out, "    out[%zu] = ", o);
+        write_sum(d, o, out);
+        fprintf(out, ";\n");
+    }
+    fprintf(out, "}\n");
+
+    /* The scalar form packs every input and output into one word */
+    if (ni <= 64 && no <= 64) {
+        fprintf(out, "\n// Bit i of `in` is input i, bit o of the result is output o\n");
+        fprintf(out, "constexpr std::uint64_t evaluate(std::uint64_t in) {\n");
+        for (size_t i = 0; i < ni; i++)
+            if (read[i]) fprintf(out, "    const std::uint64_t %s = in >> %zu;\n", d.inputs[i].c_str(), i);
+        write_products(d, used, out);
+        fprintf(out, "    return 0");
+        for (size_t o = 0; o < no; o++) {
+            fprintf(out, "\n        | ((");
+            write_sum(d, o, out);
+            fprintf(out, ") & 1) << %zu", o);
+        }
+        fprintf(out, ";\n}\n");
+    }
+    fprintf(out, "\n} // namespace %s\n", name);
+}
+
+void write_logic_header(std::span<Equation> eqns, const char* name, const char* source, FILE* out) {
+    SumOfProducts d;
+    std::vector<char> vars;
+    CharBitSet referenced = combine_vars(eqns);
+    while (char v = referenced.next_char()) vars.push_back(v);
+    std::sort(vars.begin(), vars.end());
+    for (char v : vars) d.inputs.push_back(std::string(1, v));
+
+    for (auto& eqn : eqns) {
+        d.outputs.push_back(std::string(1, eqn.get_binding()));
+        d.uses.emplace_back();
+        std::vector<ProductLiteral> term;
+        // Terms are closed by an op_and (`+`) or the final op_or, as in Equation::evaluate
+        for (Node node : eqn.get_nodes()) {
+            if (node.type == val) {
+                size_t input = std::find(vars.begin(), vars.end(), node.name) - vars.begin();
+                term.push_back({input, node.inv});
+            } else {
+                d.uses.back().push_back(d.products.size());
+                d.products.push_back(term);
+                term.clear();
+            }
+        }
+    }
+    write_design(d, name, source, out);
+}
+
+void write_logic_map_header(LogicMap& map, const char* name, const char* source, FILE* out) {
+    SumOfProducts d;
+    size_t ni = map.get_num_inputs(), np = map.get_num_products(), no = map.get_num_outputs();
+    std::span<const uint8_t> and_nodes = map.get_and_nodes(), or_nodes = map.get_or_nodes();
+    for (size_t i = 0; i < ni; i++) d.inputs.push_back("i" + std::to_string(i));
+    for (size_t o = 0; o < no; o++) d.outputs.push_back("o" + std::to_string(o));
+
+    /* Flag pairs as in LogicMap::evaluate: (0 1) v, (1 0) v', (0 0) unused, (1 1) constant 0 */
+    std::vector<bool> zero(np, true);
+    for (size_t p = 0; p < np; p++) {
+        d.products.emplace_back();
+        bool contradiction = false;
+        for (size_t i = 0; i < ni; i++) {
+            uint8_t inv = and_nodes[p * ni * 2 + i * 2], reg = and_nodes[p * ni * 2 + i * 2 + 1];
+            if (inv && reg) contradiction = true;
+            else if (inv || reg) d.products[p].push_back({i, inv != 0});
+        }
+        zero[p] = contradiction || d.products[p].empty();
+        if (zero[p]) d.products[p].clear();
+    }
+    for (size_t o = 0; o < no; o++) {
+        d.uses.emplace_back();
+        for (size_t p = 0; p < np; p++)
+            if (or_nodes[o * np + p] && !zero[p]) d.uses[o].push_back(p);
+    }
+    write_design(d, name, source, out);
+}
+
+std::string logic_header_name(const char* path) {
+    std::string name = std::filesystem::path(path).filename().string();
+    for (char& ch : name) if (!isalnum((unsigned char)ch)) ch = '_';
+    if (name.empty() || isdigit((unsigned char)name[0])) name = "design_" + name;
+    return name;
+}
@@ -1,4 +1,7 @@
 #include "matrix.hpp"
+#include "profile.hpp"
+
+#include <algorithm>
 
 Matrix::Matrix(size_t rows, size_t cols) 
     : rows(rows), cols(cols), _data(rows * cols) {}
@@ -21,3 +24,108 @@ size_t Matrix::row_size() { return rows; }
 size_t Matrix::col_size() { return cols; }
 size_t Matrix::size() { return _data.size(); }
 
+
+LUFactor::LUFactor(): n(0), flop_count(0.0) {}
+
+LUFactor::LUFactor(Matrix A): n(A.row_size()), flop_count(0.0) {
+    PROFILE_SCOPE("matrix.factor_dense");
+    first_col.resize(n);
+    first_row.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        first_col[i] = first_row[i] = i;
+        for (size_t k = 0; k < i; k++)
+            if (A(i, k) != 0.0) { first_col[i] = k; break; }
+        for (size_t k = 0; k < i; k++)
+            if (A(k, i) != 0.0) { first_row[i] = k; break; }
+    }
+    allocate();
+    for (size_t r = 0; r < n; r++)
+        for (size_t c = std::min(first_col[r], r); c < n; c++)
+            if (c < r || first_row[c] <= r) add(r, c, A(r, c));
+    factor();
+}
+
+LUFactor::LUFactor(size_t n, const std::vector<MatrixEntry>& entries): n(n), flop_count(0.0) {
+    PROFILE_SCOPE("matrix.factor");
+    first_col.resize(n);
+    first_row.resize(n);
+    for (size_t i = 0; i < n; i++) first_col[i] = first_row[i] = i;
+    for (auto& e : entries) {
+        if (e.col < e.row) first_col[e.row] = std::min(first_col[e.row], e.col);
+        else first_row[e.col] = std::min(first_row[e.col], e.row);
+    }
+    allocate();
+    for (auto& e : entries) add(e.row, e.col, e.value);
+    factor();
+}
+
+void LUFactor::allocate() {
+    row_start.resize(n + 1);
+    col_start.resize(n + 1);
+    row_start[0] = col_start[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        row_start[i + 1] = row_start[i] + (i - first_col[i]);
+        col_start[i + 1] = col_start[i] + (i - first_row[i] + 1);
+    }
+    lower.assign(row_start[n], 0.0);
+    upper.assign(col_start[n], 0.0);
+}
+
+void LUFactor::add(size_t r, size_t c, double value) {
+    if (c < r) lower[row_start[r] + c - first_col[r]] += value;
+    else upper[col_start[c] + r - first_row[c]] += value;
+}
+
+static double dot(const double* a, const double* b, size_t len) {
+    double sum = 0.0;
+    for (size_t p = 0; p < len; p++) sum += a[p] * b[p];
+    return sum;
+}
+
+/*
+    Doolittle factorization in dot product form. At step j row j of L is
+    completed from the finished columns of U, then column j of U from the
+    finished rows of L. Every inner product runs over two contiguous runs.
+*/
+void LUFactor::factor() {
+    for (size_t j = 0; j < n; j++) {
+        double* Lj = lower.data() + row_start[j];
+        for (size_t k = first_col[j]; k < j; k++) {
+            const double* Uk = upper.data() + col_start[k];
+            size_t p0 = std::max(first_col[j], first_row[k]);
+            double& l = Lj[k - first_col[j]];
+            l = (l - dot(Lj + (p0 - first_col[j]), Uk + (p0 - first_row[k]), k - p0))
+                / Uk[k - first_row[k]];
+            flop_count += 2.0 * (k - p0) + 1.0;
+        }
+
+        double* Uj = upper.data() + col_start[j];
+        for (size_t i = first_row[j]; i <= j; i++) {
+            const double* Li = lower.data() + row_start[i];
+            size_t p0 = std::max(first_col[i], first_row[j]);
+            Uj[i - first_row[j]] -= dot(Li + (p0 - first_col[i]), Uj + (p0 - first_row[j]), i - p0);
+            flop_count += 2.0 * (i - p0);
+        }
+    }
+}
+
+Vector LUFactor::solve(Vector b) {
+    PROFILE_SCOPE("matrix.solve");
+    Vector x(0.0, n);
+
+    /* forward substitute with the unit lower triangle */
+    for (size_t j = 0; j < n; j++)
+        b[j] -= dot(lower.data() + row_start[j], &b[first_col[j]], j - first_col[j]);
+
+    /* back substitute with U a column at a time */
+    for (size_t k = n; k-- > 0;) {
+        const double* Uk = upper.data() + col_start[k];
+        x[k] = b[k] / Uk[k - first_row[k]];
+        for (size_t i = first_row[k]; i < k; i++) b[i] -= Uk[i - first_row[k]] * x[k];
+    }
+    return x;
+}
+
+size_t LUFactor::size() { return n; }
+double LUFactor::flops() { return flop_count; }
+size_t LUFactor::storedEntries() { return lower.size() + upper.size(); }
@@ -0,0 +1,57 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Set while a thread runs work handed out by one of the helpers below
+static thread_local bool nested = false;
+
+/* Runs fn with `nested` set, restoring it afterwards for the calling thread */
+template <typename F>
+static void run_nested(F&& fn) {
+    bool was = nested;
+    nested = true;
+    fn();
+    nested = was;
+}
+
+unsigned int worker_count() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void parallel_for(size_t n, size_t min_chunk, const std::function<void(size_t, size_t)>& fn) {
+    if (n == 0) return;
+    size_t chunks = std::min<size_t>(worker_count(), min_chunk ? n / min_chunk : n);
+    if (chunks <= 1 || nested) { fn(0, n); return; }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+    size_t per = n / chunks, extra = n % chunks, begin = 0;
+    for (size_t c = 0; c < chunks; c++) {
+        size_t end = begin + per + (c < extra ? 1 : 0);
+        if (c + 1 == chunks) run_nested([&] { fn(begin, end); });
+        else threads.emplace_back([&fn, begin, end] { run_nested([&] { fn(begin, end); }); });
+        begin = end;
+    }
+    for (auto& t : threads) t.join();
+}
+
+void parallel_for_each(size_t n, unsigned int workers, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+    if (workers == 0) workers = worker_count();
+    size_t threads_needed = nested ? 1 : std::min<size_t>(workers, n);
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < n; i = next++) fn(i);
+    };
+    if (threads_needed == 1) { worker(); return; }
+    std::vector<std::thread> threads;
+    threads.reserve(threads_needed - 1);
+    for (size_t t = 1; t < threads_needed; t++) threads.emplace_back([&] { run_nested(worker); });
+    run_nested(worker);
+    for (auto& t : threads) t.join();
+}
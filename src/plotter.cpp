@@ -1,6 +1,16 @@
 #include "plotter.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "renderer.hpp"
 
 #include <iostream>
+#include <algorithm>
+
+// Number of samples between exact sin/cos reseeds of the synthesis phasor.
+// Must be a multiple of SAMPLE_LANES.
+static const size_t SYNTH_RESEED = 256;
+// Smallest batch worth handing to a worker thread
+static const size_t SAMPLE_CHUNK = 1 << 14;
 
 // https://stackoverflow.com/questions/4217037/catch-ctrl-c-in-c
 static volatile sig_atomic_t running = 1;
@@ -12,79 +22,268 @@ static void ctrl_c_handler(int _) {
 FourierPlotter::FourierPlotter(size_t coef_count, double base_frequency):
     max_amplitude(0.0),
     f0(base_frequency), cos_head(0), 
-    sin_head(coef_count), coef_count(coef_count) { 
-    coefs.resize(2 * coef_count, 0.0);
+    sin_head(0), coef_count(coef_count), cache_valid(false) { 
+    cos_coefs.resize(coef_count, 0.0);
+    sin_coefs.resize(coef_count, 0.0);
 }
 
 void FourierPlotter::append_cos_coef(double val) {
     if (cos_head == coef_count) return;
     if (val >= max_amplitude) max_amplitude = val;
-    coefs[cos_head++] = val;
+    cos_coefs[cos_head++] = val;
+    cache_valid = false;
 }
 
 void FourierPlotter::append_sin_coef(double val) {
-    if (sin_head == 2 * coef_count) return;
+    if (sin_head == coef_count) return;
     if (val >= max_amplitude) max_amplitude = val;
-    coefs[sin_head++] = val;
+    sin_coefs[sin_head++] = val;
+    cache_valid = false;
 }
 
 double FourierPlotter::sample(double x) {
+    PROFILE_SCOPE("plotter.sample");
     double value = 0.0;
     for (size_t i = 0; i < coef_count; i++) {
-        value += coefs[i] * cos(i * f0 * x * PI/180.0) 
-                + coefs[i + coef_count] * sin(i * f0 * x * PI/180.0);
+        value += cos_coefs[i] * cos(i * f0 * x * PI/180.0) 
+                + sin_coefs[i] * sin(i * f0 * x * PI/180.0);
     }
     return value;
 }
 
+/*
+    sin and cos of SAMPLE_LANES angles at once (Cephes sin.c/cos.c).
+
+    The angle is reduced to [-pi/4, pi/4] by the nearest multiple of pi/4 in
+    three pieces to keep the reduction exact, then both polynomials are
+    evaluated and selected per octant. There are no branches on the data, so
+    the loop vectorizes. Accurate to a few ulp for |x| < 2^30; lanes outside
+    that range, or not finite, fall back to sin() and cos().
+*/
+static void sincos_lanes(const double* x, double* s, double* c) {
+    const double FOPI = 1.27323954473516268615; // 4/pi
+    const double DP1 = 7.85398125648498535156E-1;
+    const double DP2 = 3.77489470793079817668E-8;
+    const double DP3 = 2.69515142907905952645E-15;
+    const double REDUCE_LIMIT = 1073741824.0; // 2^30, so the octant fits an int
+
+    for (size_t l = 0; l < SAMPLE_LANES; l++) {
+        // Out of range lanes reduce 0 here and are redone below
+        double ax = fabs(x[l]) < REDUCE_LIMIT ? fabs(x[l]) : 0.0;
+        int j = (int)(ax * FOPI);
+        j += j & 1;
+        double y = j;
+        double z = ((ax - y * DP1) - y * DP2) - y * DP3;
+        double zz = z * z;
+
+        double ps = z + z * zz * (((((1.58962301576546568060E-10 * zz
+            - 2.50507477628578072866E-8) * zz + 2.75573136213857245213E-6) * zz
+            - 1.98412698295895385996E-4) * zz + 8.33333333332211858878E-3) * zz
+            - 1.66666666666666307295E-1);
+        double pc = 1.0 - 0.5 * zz + zz * zz * (((((-1.13585365213876817300E-11 * zz
+            + 2.08757008419747316778E-9) * zz - 2.75573141792967388112E-7) * zz
+            + 2.48015872888517045348E-5) * zz - 1.38888888888730564116E-3) * zz
+            + 4.16666666666665929218E-2);
+
+        // Octants 4-7 flip both signs; in octants 1 and 2 (mod 4) the
+        // polynomials swap roles; octants 2 and 3 (mod 4) negate cos.
+        double flip = 1.0 - 2.0 * ((j >> 2) & 1);
+        double swap = (j ^ (j >> 1)) & 1;
+        double cos_sign = flip * (1.0 - 2.0 * ((j >> 1) & 1));
+        double sin_sign = flip * std::copysign(1.0, x[l]);
+
+        s[l] = sin_sign * (ps * (1.0 - swap) + pc * swap);
+        c[l] = cos_sign * (pc * (1.0 - swap) + ps * swap);
+    }
+    for (size_t l = 0; l < SAMPLE_LANES; l++) {
+        if (fabs(x[l]) < REDUCE_LIMIT) continue;
+        s[l] = sin(x[l]);
+        c[l] = cos(x[l]);
+    }
+}
+
+/*
+    Given the fundamental phasor (c1, s1) of SAMPLE_LANES points, sums the
+    series at each point. Harmonic k+1 is built from harmonic k by a complex
+    multiply, so there are no transcendental calls past the fundamental.
+*/
+void FourierPlotter::sum_lanes(const double* c1, const double* s1, double* out) {
+    double c[SAMPLE_LANES], s[SAMPLE_LANES], ck[SAMPLE_LANES], sk[SAMPLE_LANES], acc[SAMPLE_LANES];
+    double a0 = coef_count ? cos_coefs[0] : 0.0;
+    for (size_t l = 0; l < SAMPLE_LANES; l++) {
+        c[l] = c1[l];
+        s[l] = s1[l];
+        ck[l] = 1.0;
+        sk[l] = 0.0;
+        acc[l] = a0;
+    }
+    for (size_t i = 1; i < coef_count; i++) {
+        double a = cos_coefs[i], b = sin_coefs[i];
+        for (size_t l = 0; l < SAMPLE_LANES; l++) {
+            double next = ck[l] * c[l] - sk[l] * s[l];
+            sk[l] = sk[l] * c[l] + ck[l] * s[l];
+            ck[l] = next;
+            acc[l] += a * ck[l] + b * sk[l];
+        }
+    }
+    std::copy_n(acc, SAMPLE_LANES, out);
+}
+
+void FourierPlotter::sample_block(const double* xs, double* out, size_t n) {
+    const double w = f0 * PI / 180.0;
+    double theta[SAMPLE_LANES], c1[SAMPLE_LANES], s1[SAMPLE_LANES], res[SAMPLE_LANES];
+
+    for (size_t i = 0; i < n; i += SAMPLE_LANES) {
+        size_t m = std::min(SAMPLE_LANES, n - i);
+        for (size_t l = 0; l < SAMPLE_LANES; l++) theta[l] = l < m ? w * xs[i + l] : 0.0;
+        sincos_lanes(theta, s1, c1);
+        sum_lanes(c1, s1, res);
+        std::copy_n(res, m, out + i);
+    }
+}
+
+// Evaluates the series at every x in `xs`. Large batches are split across threads.
+void FourierPlotter::sample_many(std::span<const double> xs, std::span<double> out) {
+    PROFILE_SCOPE("plotter.sample_many");
+    size_t n = std::min(xs.size(), out.size());
+    PROFILE_COUNT("plotter.samples", n);
+    parallel_for(n, SAMPLE_CHUNK, [&](size_t begin, size_t end) {
+        sample_block(xs.data() + begin, out.data() + begin, end - begin);
+    });
+}
+
+/*
+    Evaluates the series on the grid x0, x0 + dx, x0 + 2dx, ... into `out`.
+
+    Each lane's fundamental phasor e^(iwx) is advanced by a fixed rotation
+    e^(iw SAMPLE_LANES dx) per block rather than recomputed, and is reseeded
+    every SYNTH_RESEED samples so rounding error cannot build up over long
+    grids.
+*/
+void FourierPlotter::synthesize_block(double x0, double dx, std::span<double> out) {
+    PROFILE_SCOPE("plotter.synthesize_block");
+    const double w = f0 * PI / 180.0;
+    const double step_c = cos(w * dx * SAMPLE_LANES), step_s = sin(w * dx * SAMPLE_LANES);
+    double theta[SAMPLE_LANES], c1[SAMPLE_LANES], s1[SAMPLE_LANES], res[SAMPLE_LANES];
+
+    for (size_t n = 0; n < out.size(); n += SAMPLE_LANES) {
+        if (n % SYNTH_RESEED == 0) {
+            for (size_t l = 0; l < SAMPLE_LANES; l++) theta[l] = w * (x0 + (n + l) * dx);
+            sincos_lanes(theta, s1, c1);
+        } else {
+            for (size_t l = 0; l < SAMPLE_LANES; l++) {
+                double c = c1[l] * step_c - s1[l] * step_s;
+                s1[l] = s1[l] * step_c + c1[l] * step_s;
+                c1[l] = c;
+            }
+        }
+        sum_lanes(c1, s1, res);
+        std::copy_n(res, std::min(SAMPLE_LANES, out.size() - n), out.begin() + n);
+    }
+}
+
+void FourierPlotter::synthesize(double x0, double dx, std::span<double> out) {
+    PROFILE_SCOPE("plotter.synthesize");
+    PROFILE_COUNT("plotter.samples", out.size());
+    parallel_for(out.size(), SAMPLE_CHUNK, [&](size_t begin, size_t end) {
+        synthesize_block(x0 + begin * dx, dx, out.subspan(begin, end - begin));
+    });
+}
+
+/*
+    The series repeats every 360/f0 along x, but integer samples only line up
+    again after m periods where m * 360/f0 is a whole number. Look for the
+    smallest such m and synthesize that many samples once.
+*/
+void FourierPlotter::build_period_cache() {
+    cache_valid = true;
+    period_cache.clear();
+
+    double T = 360.0 / f0;
+    if (!(T > 0.0)) return;
+    for (long m = 1; m * T <= (double)MAX_PERIOD_CACHE; m++) {
+        double len = m * T;
+        double whole = round(len);
+        if (whole >= 1.0 && fabs(len - whole) <= 1e-7) {
+            period_cache.resize((size_t)whole);
+            synthesize(0.0, 1.0, period_cache);
+            return;
+        }
+    }
+}
+
+// Fills `out` with the samples at x0, x0 + 1, x0 + 2, ...
+void FourierPlotter::sample_range(long x0, std::span<double> out) {
+    PROFILE_SCOPE("plotter.sample_range");
+    if (!cache_valid) build_period_cache();
+    if (period_cache.empty()) { synthesize((double)x0, 1.0, out); return; }
+
+    long len = (long)period_cache.size();
+    long r = x0 % len;
+    if (r < 0) r += len;
+
+    size_t n = 0;
+    while (n < out.size()) {
+        size_t run = std::min(out.size() - n, (size_t)(len - r));
+        std::copy_n(period_cache.begin() + r, run, out.begin() + n);
+        n += run;
+        r = 0;
+    }
+}
+
 double FourierPlotter::fourier_norm() {
     double value = 0.0;
     for (int i = 0; i < coef_count; i++) {
-        value += coefs[i] * coefs[i] + coefs[i + coef_count] * coefs[i + coef_count];
+        value += cos_coefs[i] * cos_coefs[i] + sin_coefs[i] * sin_coefs[i];
     }
     return sqrt(value);
 }
 
 
+// Range over one period, sampled a PLOT_BLOCK at a time so long periods need no large buffer
 std::tuple<double, double> FourierPlotter::find_min_max() {
-    long T0 = (long)(360.0 / f0) + 1;
     double min = INFINITY, max = 0.0;
-    double val;
-    for (long i = 0; i < T0; i++) {
-        val = sample((double)i);
-        min = __min(min, val);
-        max = __max(max, val);
+    if (!(f0 > 0.0)) return {min, max};
+    long T0 = (long)(360.0 / f0) + 1;
+    double block[PLOT_BLOCK];
+    for (long x = 0; x < T0; x += PLOT_BLOCK) {
+        std::span<double> part(block, std::min<long>(PLOT_BLOCK, T0 - x));
+        sample_range(x, part);
+        for (double val : part) {
+            min = std::min(min, val);
+            max = std::max(max, val);
+        }
     }
     return {min, max};
 }
 
 void FourierPlotter::start_plotter(size_t num_points) {
+    start_plotter(num_points, default_render_options());
+}
+
+void FourierPlotter::start_plotter(size_t num_points, const RenderOptions& opts) {
+    if (!(f0 > 0.0)) { fprintf(stderr, "The base frequency must be positive, got %g\n", f0); return; }
     // Handling ctrl-c allows the program to reset the terminal before exiting
     signal(SIGINT, ctrl_c_handler);
     std::tuple<double, double> range = find_min_max();
     double min = std::get<0>(range), max = std::get<1>(range);
 
+    PlotRenderer renderer(opts);
     long x = 0;
     float y;
-    int out[3];
+    std::vector<double> block(PLOT_BLOCK);
+    size_t block_pos = PLOT_BLOCK;
 
     while (num_points-->0 && running) {
         x += 1;
-        printf("x = " ORG "%0*d" RESET, 8, x);
-
-        y = (sample((double)x) - min) / (max - min);
-        printf(", y = " ORG "%.2f" RESET "|", y);
-
-        if (x % TICK_INTERVAL == 0) printf(RED "---" RESET);
-        else printf("   ");
+        if (block_pos == PLOT_BLOCK) { sample_range(x, block); block_pos = 0; }
 
-        lerp(c1, c3, out, y);
-        printf("\x1b[48;2;%d;%d;%dm", out[0], out[1], out[2]);
-        plotval(y, PLOT_WIDTH);
-        printf(RESET "\n");
+        double value = block[block_pos++];
+        y = (value - min) / (max - min);
+        renderer.point(x, value, y);
     }
     running = 1;
-    printf("\n\033[0m");
+    renderer.finish();
 }
 
 void plotval(float d, int width) {
@@ -0,0 +1,232 @@
+#include "profile.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum profile_mode { profile_off, profile_summary, profile_trace };
+
+struct TimerStat {
+    long long calls = 0;
+    long long total = 0;
+    long long min = LLONG_MAX;
+    long long max = 0;
+};
+
+struct TraceEvent {
+    unsigned int site;
+    long long start;
+    long long duration;
+};
+
+struct ThreadData {
+    unsigned int tid;
+    std::vector<TimerStat> timers;  // by site id
+    std::vector<long long> counters; // by site id
+    std::vector<TraceEvent> events;
+    long long dropped = 0;
+};
+
+/* Only contended while the report copies the data out */
+struct ThreadProfile {
+    std::mutex lock;
+    ThreadData data;
+};
+
+/* Shared state, built on first use so sites in other files can register during static init */
+struct ProfileState {
+    std::mutex lock;
+    std::vector<const char*> names; // by site id
+    std::vector<std::shared_ptr<ThreadProfile>> threads;
+    profile_mode mode = profile_off;
+    std::string trace_path = "cajun_trace.json";
+    long long epoch = 0;
+    bool reporting = false;
+};
+
+static ProfileState& state() {
+    static ProfileState s;
+    return s;
+}
+
+std::atomic<bool> profile_on(false);
+
+static bool start_from_env() {
+    const char* mode = getenv("CAJUN_PROFILE");
+    if (mode && *mode && !profile_start(mode))
+        fprintf(stderr, "Unknown CAJUN_PROFILE mode: %s (expected summary, trace or trace:<file>)\n", mode);
+    return profile_on;
+}
+
+static const bool started_from_env = start_from_env();
+
+ProfileSite::ProfileSite(const char* name): name(name) {
+    ProfileState& s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    id = s.names.size();
+    s.names.push_back(name);
+}
+
+long long profile_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static ThreadProfile& local() {
+    thread_local std::shared_ptr<ThreadProfile> mine = [] {
+        ProfileState& s = state();
+        auto p = std::make_shared<ThreadProfile>();
+        std::lock_guard<std::mutex> guard(s.lock);
+        p->data.tid = s.threads.size();
+        s.threads.push_back(p);
+        return p;
+    }();
+    return *mine;
+}
+
+void profile_record(const ProfileSite& site, long long start, long long end) {
+    ThreadProfile& p = local();
+    std::lock_guard<std::mutex> guard(p.lock);
+    ThreadData& t = p.data;
+    if (t.timers.size() <= site.id) t.timers.resize(site.id + 1);
+    TimerStat& st = t.timers[site.id];
+    long long d = end - start;
+    st.calls++;
+    st.total += d;
+    st.min = std::min(st.min, d);
+    st.max = std::max(st.max, d);
+
+    if (state().mode != profile_trace) return;
+    if (t.events.size() < MAX_TRACE_EVENTS) t.events.push_back({site.id, start, d});
+    else t.dropped++;
+}
+
+void profile_add(const ProfileSite& site, long long n) {
+    ThreadProfile& p = local();
+    std::lock_guard<std::mutex> guard(p.lock);
+    ThreadData& t = p.data;
+    if (t.counters.size() <= site.id) t.counters.resize(site.id + 1, 0);
+    t.counters[site.id] += n;
+}
+
+/* Timers and counters of all threads, merged by name */
+struct Merged {
+    std::string name;
+    TimerStat timer;
+    long long count = 0;
+    bool counter = false;
+};
+
+static std::vector<Merged> merge(ProfileState& s, const std::vector<ThreadData>& threads) {
+    std::vector<Merged> out;
+    auto find = [&out](const char* name, bool counter) -> Merged& {
+        for (auto& m : out) if (m.name == name && m.counter == counter) return m;
+        out.push_back({name, {}, 0, counter});
+        return out.back();
+    };
+    for (auto& t : threads) {
+        for (size_t i = 0; i < t.timers.size(); i++) {
+            const TimerStat& st = t.timers[i];
+            if (!st.calls) continue;
+            TimerStat& m = find(s.names[i], false).timer;
+            m.calls += st.calls;
+            m.total += st.total;
+            m.min = std::min(m.min, st.min);
+            m.max = std::max(m.max, st.max);
+        }
+        for (size_t i = 0; i < t.counters.size(); i++)
+            if (t.counters[i]) find(s.names[i], true).count += t.counters[i];
+    }
+    std::stable_sort(out.begin(), out.end(), [](const Merged& a, const Merged& b) {
+        if (a.counter != b.counter) return !a.counter;
+        return a.counter ? a.name < b.name : a.timer.total > b.timer.total;
+    });
+    return out;
+}
+
+static void print_summary(FILE* out, ProfileState& s, const std::vector<ThreadData>& threads) {
+    std::vector<Merged> rows = merge(s, threads);
+    fprintf(out, "-------------------------------------------------------------------------------\n");
+    fprintf(out, " %-32s %10s %12s %10s %10s\n", "Profile", "calls", "total ms", "mean us", "max us");
+    fprintf(out, "-------------------------------------------------------------------------------\n");
+    for (auto& r : rows) {
+        if (r.counter) continue;
+        fprintf(out, " %-32s %10lld %12.3f %10.3f %10.3f\n", r.name.c_str(), r.timer.calls,
+            r.timer.total * 1e-6, r.timer.total * 1e-3 / r.timer.calls, r.timer.max * 1e-3);
+    }
+    bool counters = false;
+    for (auto& r : rows) {
+        if (!r.counter) continue;
+        if (!counters) fprintf(out, "-------------------------------------------------------------------------------\n");
+        counters = true;
+        fprintf(out, " %-32s %10lld\n", r.name.c_str(), r.count);
+    }
+    fprintf(out, "-------------------------------------------------------------------------------\n");
+}
+
+/* Chrome trace event format: complete ("X") events in microseconds, counters as "C" */
+static void write_trace(ProfileState& s, const std::vector<ThreadData>& threads) {
+    FILE* out = fopen(s.trace_path.c_str(), "w");
+    if (!out) { fprintf(stderr, "Could not open file: %s\n", s.trace_path.c_str()); return; }
+    const char* sep = "";
+    long long last = 0, dropped = 0;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (auto& t : threads) {
+        for (auto& e : t.events) {
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                sep, s.names[e.site], t.tid, (e.start - s.epoch) * 1e-3, e.duration * 1e-3);
+            sep = ",\n";
+            last = std::max(last, e.start + e.duration - s.epoch);
+        }
+        dropped += t.dropped;
+    }
+    for (auto& r : merge(s, threads)) {
+        if (!r.counter) continue;
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+            sep, r.name.c_str(), last * 1e-3, r.count);
+        sep = ",\n";
+    }
+    fprintf(out, "\n],\"otherData\":{\"dropped_events\":%lld}}\n", dropped);
+    fclose(out);
+    fprintf(stderr, "Profile trace written to %s\n", s.trace_path.c_str());
+}
+
+/*
+    Threads may still be inside a marked scope, so each buffer is copied
+    under its own lock and the report works from the copies.
+*/
+static void report() {
+    ProfileState& s = state();
+    profile_on = false;
+    std::lock_guard<std::mutex> guard(s.lock);
+    std::vector<ThreadData> threads;
+    threads.reserve(s.threads.size());
+    for (auto& t : s.threads) {
+        std::lock_guard<std::mutex> thread_guard(t->lock);
+        threads.push_back(t->data);
+    }
+    if (s.mode == profile_summary) print_summary(stderr, s, threads);
+    else if (s.mode == profile_trace) write_trace(s, threads);
+}
+
+bool profile_start(const char* mode) {
+    ProfileState& s = state();
+    if (!strcmp(mode, "summary")) s.mode = profile_summary;
+    else if (!strcmp(mode, "trace")) s.mode = profile_trace;
+    else if (!strncmp(mode, "trace:", 6) && mode[6]) { s.mode = profile_trace; s.trace_path = mode + 6; }
+    else return false;
+
+    if (!s.reporting) {
+        s.reporting = true;
+        s.epoch = profile_now();
+        atexit(report);
+    }
+    profile_on = true;
+    return true;
+}
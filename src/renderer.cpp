@@ -0,0 +1,150 @@
+#include "renderer.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+// Longest terminal line: escapes, x, y, tick and PLOT_WIDTH columns of padding
+static const size_t MAX_LINE = PLOT_WIDTH + 128;
+static const size_t DEFAULT_FRAME_LINES = 64;
+
+RenderOptions default_render_options(FILE* out) {
+    RenderOptions opts;
+    opts.mode = render_terminal;
+    opts.out = out;
+    opts.lines_per_frame = DEFAULT_FRAME_LINES;
+    opts.max_fps = 0.0;
+    opts.skip_frames = false;
+    return opts;
+}
+
+PlotRenderer::PlotRenderer(RenderOptions opts):
+    opts(opts), lines_in_frame(0), frames_written(0), frames_skipped(0) {
+    if (this->opts.lines_per_frame == 0) this->opts.lines_per_frame = 1;
+    buffer.reserve(this->opts.lines_per_frame * MAX_LINE);
+
+    frame_interval = std::chrono::steady_clock::duration::zero();
+    if (opts.max_fps > 0.0)
+        frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / opts.max_fps));
+    next_slot = std::chrono::steady_clock::now();
+}
+
+PlotRenderer::~PlotRenderer() {
+    if (!buffer.empty()) flush_frame();
+}
+
+// Appends `val` in decimal, zero padded to at least `width` digits
+static void append_padded(std::string& buf, long val, int width) {
+    char digits[24];
+    auto res = std::to_chars(digits, digits + sizeof(digits), val);
+    int len = (int)(res.ptr - digits);
+    if (len < width) buf.append(width - len, '0');
+    buf.append(digits, len);
+}
+
+static void append_int(std::string& buf, int val) {
+    char digits[16];
+    auto res = std::to_chars(digits, digits + sizeof(digits), val);
+    buf.append(digits, res.ptr - digits);
+}
+
+// Same text as printf("x = %08d, y = %.2f|...") followed by plotval()
+void PlotRenderer::append_terminal_line(long x, float y) {
+    char num[32];
+    int colour[3];
+
+    buffer.append("x = " ORG);
+    append_padded(buffer, x, 8);
+    buffer.append(RESET ", y = " ORG);
+    auto res = std::to_chars(num, num + sizeof(num), (double)y, std::chars_format::fixed, 2);
+    buffer.append(num, res.ptr - num);
+    buffer.append(RESET "|");
+
+    if (x % TICK_INTERVAL == 0) buffer.append(RED "---" RESET);
+    else buffer.append("   ");
+
+    lerp(c1, c3, colour, y);
+    buffer.append("\x1b[48;2;");
+    append_int(buffer, colour[0]);
+    buffer.push_back(';');
+    append_int(buffer, colour[1]);
+    buffer.push_back(';');
+    append_int(buffer, colour[2]);
+    buffer.push_back('m');
+
+    int width = (int)(y * PLOT_WIDTH) + 1;
+    if (width > 1) buffer.append(width - 1, ' ');
+    buffer.append("*" RESET "\n");
+}
+
+void PlotRenderer::append_csv_line(long x, double value) {
+    char num[32];
+    auto res = std::to_chars(num, num + sizeof(num), x);
+    buffer.append(num, res.ptr - num);
+    buffer.push_back(',');
+    res = std::to_chars(num, num + sizeof(num), value);
+    buffer.append(num, res.ptr - num);
+    buffer.push_back('\n');
+}
+
+void PlotRenderer::append_binary_record(long x, double value) {
+    std::int64_t x64 = x;
+    char rec[sizeof(x64) + sizeof(value)];
+    memcpy(rec, &x64, sizeof(x64));
+    memcpy(rec + sizeof(x64), &value, sizeof(value));
+    buffer.append(rec, sizeof(rec));
+}
+
+void PlotRenderer::point(long x, double value, float y) {
+    switch (opts.mode) {
+        case render_terminal: append_terminal_line(x, y); break;
+        case render_csv: append_csv_line(x, value); break;
+        case render_binary: append_binary_record(x, value); break;
+    }
+    if (++lines_in_frame >= opts.lines_per_frame) flush_frame();
+}
+
+/*
+    Rate limiting only applies to the terminal view; headless streams are
+    data and are always written in full.
+*/
+void PlotRenderer::flush_frame() {
+    lines_in_frame = 0;
+    if (buffer.empty()) return;
+
+    if (opts.mode == render_terminal && opts.max_fps > 0.0) {
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_slot) {
+            if (opts.skip_frames) {
+                frames_skipped++;
+                buffer.clear();
+                return;
+            }
+            std::this_thread::sleep_until(next_slot);
+            now = next_slot;
+        }
+        next_slot = now + frame_interval;
+    }
+
+    fwrite(buffer.data(), 1, buffer.size(), opts.out);
+    fflush(opts.out);
+    buffer.clear();
+    frames_written++;
+}
+
+void PlotRenderer::finish() {
+    // The last partial frame is always shown so the plot ends where it stopped
+    if (!buffer.empty()) {
+        next_slot = std::chrono::steady_clock::now();
+        flush_frame();
+    }
+    if (opts.mode == render_terminal) {
+        fputs("\n\033[0m", opts.out);
+        fflush(opts.out);
+    }
+}
+
+size_t PlotRenderer::get_frames_written() { return frames_written; }
+size_t PlotRenderer::get_frames_skipped() { return frames_skipped; }
@@ -0,0 +1,156 @@
+#include "result_sink.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include "profile.hpp"
+
+// Bytes composed before they are written out
+static const size_t FLUSH_BYTES = 1 << 16;
+static const size_t DEFAULT_MAX_PENDING = 1024;
+
+ResultLayout result_layout(Circuit& c, const char* point_name) {
+    ResultLayout layout;
+    layout.point_name = point_name;
+    layout.nodes.resize(c.nodeCount());
+    std::iota(layout.nodes.begin(), layout.nodes.end(), 0);
+    std::sort(layout.nodes.begin(), layout.nodes.end(),
+        [&c](unsigned int a, unsigned int b) { return c.nodeLabel(a) < c.nodeLabel(b); });
+    for (unsigned int id : layout.nodes) layout.labels.push_back(c.nodeLabel(id));
+    for (unsigned int i = 0; i < c.componentCount(); i++)
+        if (c.component(i).type == voltage) layout.currents.push_back(c.component(i).name);
+    return layout;
+}
+
+SinkOptions default_sink_options(FILE* out, const char* path) {
+    SinkOptions opts;
+    size_t len = strlen(path);
+    opts.format = len >= 4 && !strcmp(path + len - 4, ".csv") ? sink_csv : sink_binary;
+    opts.out = out;
+    opts.async = true;
+    opts.max_pending = DEFAULT_MAX_PENDING;
+    return opts;
+}
+
+ResultSink::ResultSink(SinkOptions opts, ResultLayout layout):
+    opts(opts), layout(std::move(layout)), write_failed(false), done(false) {
+    if (this->opts.max_pending == 0) this->opts.max_pending = 1;
+    buffer.reserve(FLUSH_BYTES + 4096);
+    write_header();
+    if (opts.async) writer = std::thread(&ResultSink::run_writer, this);
+}
+
+ResultSink::~ResultSink() {
+    finish();
+}
+
+static void append_u32(std::string& buf, std::uint32_t v) {
+    buf.append((const char*)&v, sizeof(v));
+}
+
+static void append_name(std::string& buf, const std::string& s) {
+    append_u32(buf, s.size());
+    buf.append(s);
+}
+
+static void append_double(std::string& buf, double v) {
+    char num[32];
+    auto res = std::to_chars(num, num + sizeof(num), v);
+    buf.append(num, res.ptr - num);
+}
+
+void ResultSink::write_header() {
+    if (opts.format == sink_binary) {
+        buffer.append("CAJRES1\n", 8);
+        append_u32(buffer, layout.nodes.size());
+        append_u32(buffer, layout.currents.size());
+        append_name(buffer, layout.point_name);
+        for (unsigned int label : layout.labels) append_u32(buffer, label);
+        for (auto& name : layout.currents) append_name(buffer, name);
+    } else {
+        buffer.append(layout.point_name);
+        for (unsigned int label : layout.labels) {
+            buffer.append(",V(");
+            buffer.append(std::to_string(label));
+            buffer.push_back(')');
+        }
+        for (auto& name : layout.currents) buffer.append(",I(" + name + ")");
+        buffer.push_back('\n');
+    }
+}
+
+/* `row` is the point followed by the voltages and currents */
+void ResultSink::append_row(const std::vector<double>& row) {
+    if (opts.format == sink_binary) buffer.append((const char*)row.data(), row.size() * sizeof(double));
+    else {
+        for (size_t k = 0; k < row.size(); k++) {
+            if (k) buffer.push_back(',');
+            append_double(buffer, row[k]);
+        }
+        buffer.push_back('\n');
+    }
+    if (buffer.size() >= FLUSH_BYTES) flush_buffer();
+}
+
+void ResultSink::flush_buffer() {
+    if (buffer.empty()) return;
+    if (fwrite(buffer.data(), 1, buffer.size(), opts.out) != buffer.size()) write_failed = true;
+    buffer.clear();
+}
+
+/* Takes every queued row at once so the lock is held briefly */
+void ResultSink::run_writer() {
+    std::deque<std::vector<double>> rows;
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        ready.wait(guard, [this]() { return done || !pending.empty(); });
+        if (pending.empty()) break;
+        rows.swap(pending);
+        space.notify_all();
+        guard.unlock();
+        {
+            PROFILE_SCOPE("sink.format");
+            for (auto& row : rows) append_row(row);
+        }
+        guard.lock();
+        for (auto& row : rows) spare.push_back(std::move(row));
+        rows.clear();
+    }
+}
+
+void ResultSink::write(double point, const CircuitSolution& sol) {
+    PROFILE_SCOPE("sink.write");
+    std::vector<double> row;
+    if (opts.async) {
+        std::unique_lock<std::mutex> guard(lock);
+        space.wait(guard, [this]() { return pending.size() < opts.max_pending; });
+        if (!spare.empty()) { row = std::move(spare.back()); spare.pop_back(); }
+    }
+    row.resize(1 + layout.nodes.size() + layout.currents.size());
+    row[0] = point;
+    for (size_t k = 0; k < layout.nodes.size(); k++) row[1 + k] = sol.voltage[layout.nodes[k]];
+    for (size_t k = 0; k < layout.currents.size(); k++)
+        row[1 + layout.nodes.size() + k] = k < sol.current.size() ? sol.current[k] : NAN;
+
+    if (!opts.async) { append_row(row); return; }
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(std::move(row));
+    ready.notify_one();
+}
+
+bool ResultSink::finish() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done = true;
+        }
+        ready.notify_one();
+        writer.join();
+    }
+    flush_buffer();
+    if (fflush(opts.out) != 0 || ferror(opts.out)) write_failed = true;
+    return !write_failed;
+}
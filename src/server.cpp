@@ -0,0 +1,472 @@
+#include "server.hpp"
+
+#if defined(_WIN32)
+
+int run_server(const char*, size_t) {
+    fprintf(stderr, "Server mode needs Unix domain sockets and is not available on this platform.\n");
+    return 1;
+}
+
+int query_server(const char*, const std::string&, FILE*) {
+    fprintf(stderr, "Server mode needs Unix domain sockets and is not available on this platform.\n");
+    return 1;
+}
+
+#else
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "circuit.hpp"
+#include "logic.hpp"
+#include "logic_arr.hpp"
+#include "profile.hpp"
+
+enum design_kind { design_circuit, design_logic, design_logic_map };
+
+/* A parsed file and what has been worked out from it */
+struct CachedDesign {
+    std::mutex lock; // held while a request uses the design
+    design_kind kind;
+    long long mtime;
+    uintmax_t size;
+    uint64_t hash;
+    Circuit circuit;
+    CircuitSolution solution;
+    LogicFile eqns;
+    LogicMap map;
+};
+
+// FNV-1a over the file contents
+static bool hash_file(const std::string& path, uint64_t& hash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    hash = 14695981039346656037ull;
+    char buffer[1 << 16];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount()) {
+        for (std::streamsize i = 0; i < file.gcount(); i++) {
+            hash ^= (unsigned char)buffer[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return true;
+}
+
+static bool has_extension(const std::string& path, const char* ext) {
+    return std::filesystem::path(path).extension() == ext;
+}
+
+class DesignCache {
+    std::mutex lock;
+    size_t capacity;
+    std::list<std::pair<std::string, std::shared_ptr<CachedDesign>>> order; // most recent first
+    std::unordered_map<std::string, decltype(order)::iterator> index;
+
+    std::shared_ptr<CachedDesign> load(const std::string& path, std::string& error);
+
+    public:
+    std::atomic<size_t> hits = 0, misses = 0, touched = 0;
+
+    DesignCache(size_t capacity): capacity(capacity ? capacity : 1) {}
+    std::shared_ptr<CachedDesign> get(const std::string& path, bool& cached, std::string& error);
+    size_t size();
+    size_t get_capacity() { return capacity; }
+};
+
+std::shared_ptr<CachedDesign> DesignCache::load(const std::string& path, std::string& error) {
+    PROFILE_SCOPE("server.load");
+    auto d = std::make_shared<CachedDesign>();
+    if (!hash_file(path, d->hash)) { error = "could not open " + path; return nullptr; }
+
+    bool success = true;
+    if (has_extension(path, ".cir")) {
+        d->kind = design_circuit;
+        d->circuit = Circuit::createFromFile(path.c_str(), success, error);
+        if (!success) return nullptr;
+        d->solution = d->circuit.solve();
+    } else if (has_extension(path, ".logic")) {
+        d->kind = design_logic;
+        d->eqns = parse_file(path.c_str(), success);
+        if (success && d->eqns.get_skipped() != 0) {
+            error = std::to_string(d->eqns.get_skipped()) + " lines could not be parsed in " + path;
+            return nullptr;
+        }
+    } else if (has_extension(path, ".larr")) {
+        d->kind = design_logic_map;
+        d->map = LogicMap::create_from_file(path.c_str(), success);
+    } else {
+        error = "unknown design type (expected .cir, .logic or .larr): " + path;
+        return nullptr;
+    }
+    if (!success) { error = "could not read " + path; return nullptr; }
+    return d;
+}
+
+std::shared_ptr<CachedDesign> DesignCache::get(const std::string& path, bool& cached, std::string& error) {
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) { error = "could not open " + path; return nullptr; }
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) { error = "could not open " + path; return nullptr; }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = index.find(path);
+        if (it != index.end()) {
+            std::shared_ptr<CachedDesign> d = it->second->second;
+            bool same = d->mtime == mtime && d->size == size;
+            uint64_t hash;
+            /* Touched but unchanged files keep their entry */
+            if (!same && d->size == size && hash_file(path, hash) && hash == d->hash) {
+                d->mtime = mtime;
+                touched++;
+                same = true;
+            }
+            if (same) {
+                order.splice(order.begin(), order, it->second);
+                hits++;
+                cached = true;
+                return d;
+            }
+        }
+        misses++;
+    }
+
+    /* Parse without holding the cache, so other designs stay available meanwhile */
+    cached = false;
+    std::shared_ptr<CachedDesign> d = load(path, error);
+    if (!d) return nullptr;
+    d->mtime = mtime;
+    d->size = size;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(path);
+    if (it != index.end()) order.erase(it->second);
+    order.emplace_front(path, d);
+    index[path] = order.begin();
+    while (order.size() > capacity) {
+        index.erase(order.back().first);
+        order.pop_back();
+    }
+    return d;
+}
+
+size_t DesignCache::size() {
+    std::lock_guard<std::mutex> guard(lock);
+    return order.size();
+}
+
+/* JSON output helpers; non-finite numbers (floating nodes) become null */
+static void put_number(std::string& out, double v) {
+    if (!std::isfinite(v)) { out += "null"; return; }
+    char buffer[32];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), v);
+    out.append(buffer, res.ptr);
+}
+
+static void put_string(std::string& out, const std::string& s) {
+    out += '"';
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') { out += '\\'; out += ch; }
+        else if ((unsigned char)ch < 0x20) out += ' ';
+        else out += ch;
+    }
+    out += '"';
+}
+
+static std::string error_reply(const std::string& message) {
+    std::string out = "{\"ok\":false,\"error\":";
+    put_string(out, message);
+    return out + "}";
+}
+
+static bool read_number(const std::string& text, double& value) {
+    char* end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+/* Node ids of a circuit in the order of their labels */
+static std::vector<unsigned int> nodes_by_label(Circuit& c) {
+    std::vector<unsigned int> ids(c.nodeCount());
+    for (unsigned int i = 0; i < ids.size(); i++) ids[i] = i;
+    std::sort(ids.begin(), ids.end(), [&c](unsigned int a, unsigned int b) { return c.nodeLabel(a) < c.nodeLabel(b); });
+    return ids;
+}
+
+static std::string reply_solve(CachedDesign& d, bool cached) {
+    Circuit& c = d.circuit;
+    std::string out = "{\"ok\":true,\"cached\":";
+    out += cached ? "true" : "false";
+    out += ",\"nodes\":{";
+    const char* sep = "";
+    for (unsigned int id : nodes_by_label(c)) {
+        out += sep;
+        out += '"' + std::to_string(c.nodeLabel(id)) + "\":";
+        put_number(out, d.solution.voltage[id]);
+        sep = ",";
+    }
+    out += "},\"currents\":{";
+    sep = "";
+    for (unsigned int i = 0, v = 0; i < c.componentCount(); i++) {
+        Component cp = c.component(i);
+        if (cp.type != voltage) continue;
+        out += sep;
+        put_string(out, cp.name);
+        out += ':';
+        put_number(out, d.solution.current[v++]);
+        sep = ",";
+    }
+    return out + "}}";
+}
+
+/* Steps one component with incremental re-solves, then puts its value back */
+static std::string reply_sweep(CachedDesign& d, bool cached, const std::vector<std::string>& args) {
+    double from, to, steps;
+    if (args.size() != 6 || !read_number(args[3], from) || !read_number(args[4], to) || !read_number(args[5], steps) || steps < 0)
+        return error_reply("usage: sweep <netlist> <component> <from> <to> <steps>");
+    Circuit& c = d.circuit;
+    const char* name = args[2].c_str();
+    double original = NAN;
+    for (unsigned int i = 0; i < c.componentCount(); i++)
+        if (!strcmp(c.component(i).name, name)) { original = c.component(i).value; break; }
+    if (std::isnan(original)) return error_reply("no component " + args[2]);
+
+    std::vector<unsigned int> ids = nodes_by_label(c);
+    std::string out = "{\"ok\":true,\"cached\":";
+    out += cached ? "true" : "false";
+    out += ",\"component\":";
+    put_string(out, args[2]);
+    out += ",\"nodes\":[";
+    for (size_t k = 0; k < ids.size(); k++) out += (k ? "," : "") + std::to_string(c.nodeLabel(ids[k]));
+    out += "],\"steps\":[";
+    for (long k = 0; k <= (long)steps; k++) {
+        double value = steps > 0 ? from + (to - from) * k / (long)steps : from;
+        c.setValue(name, value);
+        CircuitSolution sol = c.resolve();
+        out += k ? ",{\"value\":" : "{\"value\":";
+        put_number(out, value);
+        out += ",\"voltages\":[";
+        for (size_t n = 0; n < ids.size(); n++) {
+            if (n) out += ',';
+            put_number(out, sol.voltage[ids[n]]);
+        }
+        out += "],\"currents\":[";
+        for (size_t v = 0; v < sol.current.size(); v++) {
+            if (v) out += ',';
+            put_number(out, sol.current[v]);
+        }
+        out += "]}";
+    }
+    c.setValue(name, original);
+    return out + "]}";
+}
+
+static std::string reply_eval(CachedDesign& d, bool cached, const std::vector<std::string>& args) {
+    std::string out = "{\"ok\":true,\"cached\":";
+    out += cached ? "true" : "false";
+    out += ",\"values\":";
+
+    if (d.kind == design_logic) {
+        std::array<bool, 26> map;
+        map.fill(false);
+        std::istringstream items(args.size() > 2 ? args[2] : "");
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (item.size() != 3 || item[0] < 'A' || item[0] > 'Z' || item[1] != '=' || (item[2] != '0' && item[2] != '1'))
+                return error_reply("expected assignments like A=1,B=0");
+            map[item[0] - 'A'] = item[2] == '1';
+        }
+        out += '{';
+        for (size_t i = 0; i < d.eqns.size(); i++) {
+            out += i ? ",\"" : "\"";
+            out += d.eqns[i].get_binding();
+            out += d.eqns[i].evaluate(map) ? "\":1" : "\":0";
+        }
+        return out + "}}";
+    }
+
+    size_t n = d.map.get_num_inputs();
+    if (args.size() != 3 || args[2].size() != n || args[2].find_first_not_of("01") != std::string::npos)
+        return error_reply("expected " + std::to_string(n) + " input bits");
+    std::unique_ptr<bool[]> inputs(new bool[n]);
+    for (size_t i = 0; i < n; i++) inputs[i] = args[2][i] == '1';
+    out += '[';
+    for (size_t o = 0; o < d.map.get_num_outputs(); o++) {
+        if (o) out += ',';
+        out += d.map.evaluate(std::span<bool>(inputs.get(), n), o) ? '1' : '0';
+    }
+    return out + "]}";
+}
+
+static std::string handle(const std::string& line, DesignCache& cache, bool& stop) {
+    PROFILE_SCOPE("server.request");
+    std::istringstream words(line);
+    std::vector<std::string> args;
+    std::string word;
+    while (words >> word) args.push_back(word);
+    if (args.empty()) return error_reply("empty request");
+
+    const std::string& cmd = args[0];
+    if (cmd == "shutdown") { stop = true; return "{\"ok\":true}"; }
+    if (cmd == "stats") {
+        std::string out = "{\"ok\":true,\"entries\":" + std::to_string(cache.size());
+        out += ",\"capacity\":" + std::to_string(cache.get_capacity());
+        out += ",\"hits\":" + std::to_string(cache.hits.load());
+        out += ",\"misses\":" + std::to_string(cache.misses.load());
+        out += ",\"touched\":" + std::to_string(cache.touched.load());
+        return out + "}";
+    }
+    if (cmd != "solve" && cmd != "sweep" && cmd != "eval") return error_reply("unknown request " + cmd);
+    if (args.size() < 2) return error_reply("missing file name");
+
+    bool cached;
+    std::string error;
+    std::shared_ptr<CachedDesign> d = cache.get(args[1], cached, error);
+    if (!d) return error_reply(error);
+
+    std::lock_guard<std::mutex> guard(d->lock);
+    bool circuit = d->kind == design_circuit;
+    if (cmd == "solve" && circuit) return reply_solve(*d, cached);
+    if (cmd == "sweep" && circuit) return reply_sweep(*d, cached, args);
+    if (cmd == "eval" && !circuit) return reply_eval(*d, cached, args);
+    return error_reply(cmd + " does not apply to " + args[1]);
+}
+
+static bool send_all(int fd, const std::string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+static bool make_address(const char* path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) { fprintf(stderr, "Socket path too long: %s\n", path); return false; }
+    strcpy(addr.sun_path, path);
+    return true;
+}
+
+/* An accepted connection; its fd stays open until the thread is joined so stop() can cut it off */
+struct Connection {
+    int fd;
+    std::atomic<bool> finished{false};
+    std::thread thread;
+};
+
+/* Answers requests on one connection until the client hangs up */
+static void serve_client(Connection& conn, DesignCache& cache, std::atomic<bool>& stop, int listener) {
+    std::string pending;
+    char buffer[4096];
+    ssize_t n;
+    while (!stop && (n = read(conn.fd, buffer, sizeof(buffer))) > 0) {
+        pending.append(buffer, n);
+        size_t eol;
+        while ((eol = pending.find('\n')) != std::string::npos) {
+            bool shutdown_requested = false;
+            std::string reply = handle(pending.substr(0, eol), cache, shutdown_requested) + "\n";
+            pending.erase(0, eol + 1);
+            if (!send_all(conn.fd, reply)) break;
+            if (shutdown_requested) {
+                stop = true;
+                shutdown(listener, SHUT_RDWR);
+                break;
+            }
+        }
+    }
+    conn.finished = true;
+}
+
+/* Joins the connections whose client has gone, closing their sockets */
+static void reap(std::list<Connection>& conns, bool all) {
+    for (auto it = conns.begin(); it != conns.end();) {
+        if (!all && !it->finished) { ++it; continue; }
+        it->thread.join();
+        close(it->fd);
+        it = conns.erase(it);
+    }
+}
+
+int run_server(const char* socket_path, size_t cache_entries) {
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) { perror("socket"); return 1; }
+    unlink(socket_path);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 64) < 0) {
+        perror(socket_path);
+        close(listener);
+        return 1;
+    }
+    fprintf(stderr, "Listening on %s\n", socket_path);
+
+    DesignCache cache(cache_entries);
+    std::atomic<bool> stop(false);
+    std::list<Connection> conns; // only touched by this thread
+    while (!stop) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (stop || errno != EINTR) break;
+            continue;
+        }
+        reap(conns, false);
+        Connection& conn = conns.emplace_back();
+        conn.fd = fd;
+        conn.thread = std::thread(serve_client, std::ref(conn), std::ref(cache), std::ref(stop), listener);
+    }
+    stop = true;
+    close(listener);
+    unlink(socket_path);
+    /* Wake connections blocked in read, then wait for each to finish its request */
+    for (auto& conn : conns) shutdown(conn.fd, SHUT_RDWR);
+    reap(conns, true);
+    return 0;
+}
+
+int query_server(const char* socket_path, const std::string& request, FILE* out) {
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror(socket_path);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    if (!send_all(fd, request + "\n")) { close(fd); return 1; }
+
+    std::string reply;
+    char buffer[4096];
+    ssize_t n;
+    while (reply.find('\n') == std::string::npos && (n = read(fd, buffer, sizeof(buffer))) > 0) reply.append(buffer, n);
+    close(fd);
+    fputs(reply.c_str(), out);
+    return reply.rfind("{\"ok\":true", 0) == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "subcircuit.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "matrix.hpp"
+#include "profile.hpp"
+
+static bool build(std::vector<std::shared_ptr<Subcircuit>>& defs, unsigned int d, std::vector<char>& active, std::string& error) {
+	Subcircuit& s = *defs[d];
+	if (s.built) return true;
+	if (active[d]) { error = std::string("Subcircuit ") + s.name + " uses itself."; return false; }
+	PROFILE_SCOPE("circuit.macromodel");
+	active[d] = 1;
+	for (auto& x : s.inst) if (!build(defs, x.def, active, error)) return false;
+
+	/* Unknowns in order: ports, internal nodes, voltage source currents. -1 is ground. */
+	const size_t P = s.portCount();
+	std::vector<unsigned int> nodeLabels(s.ports);
+	auto index = [&](unsigned int label) -> long {
+		if (label == 0) return -1;
+		auto it = std::find(nodeLabels.begin(), nodeLabels.end(), label);
+		if (it != nodeLabels.end()) return it - nodeLabels.begin();
+		nodeLabels.push_back(label);
+		return nodeLabels.size() - 1;
+	};
+	for (auto& cp : s.comp) { index(cp.n1); index(cp.n2); }
+	/*
+	    A source between ports (or a port and ground) fixes a port voltage,
+	    which no conductance block over the ports can express.
+	*/
+	for (auto& cp : s.comp)
+		if (cp.type == voltage && index(cp.n1) < (long)P && index(cp.n2) < (long)P) {
+			error = std::string("Subcircuit ") + s.name + " has voltage source " + cp.name +
+				" across its ports, which a port macromodel cannot represent; move it outside the subcircuit.";
+			return false;
+		}
+	for (auto& x : s.inst) for (unsigned int n : x.nodes) index(n);
+	size_t nodes = nodeLabels.size(), nV = 0;
+	for (auto& cp : s.comp) if (cp.type == voltage) nV++;
+	const size_t N = nodes + nV, m = N - P;
+
+	/* Modified nodal analysis terms of the definition, as in Circuit::buildSystem */
+	std::vector<MatrixEntry> A;
+	std::vector<double> b(N, 0.0);
+	auto stamp = [&A](long r, long c, double v) { if (r >= 0 && c >= 0) A.push_back({(size_t)r, (size_t)c, v}); };
+	auto inject = [&b](long r, double v) { if (r >= 0) b[r] += v; };
+	size_t cV = nodes;
+	for (auto& cp : s.comp) {
+		long n1 = index(cp.n1), n2 = index(cp.n2);
+		double g;
+		switch (cp.type) {
+			case resistor:
+				g = 1.0/cp.value;
+				stamp(n1, n2, -g);
+				stamp(n2, n1, -g);
+				stamp(n1, n1, g);
+				stamp(n2, n2, g);
+			break;
+			case voltage:
+				stamp(n1, cV, 1.0);
+				stamp(cV, n1, 1.0);
+				stamp(n2, cV, -1.0);
+				stamp(cV, n2, -1.0);
+				b[cV++] = -cp.value;
+			break;
+			case current:
+				inject(n1, -cp.value);
+				inject(n2, cp.value);
+			break;
+		}
+		s.grounded = s.grounded || (cp.type != current && (cp.n1 == 0 || cp.n2 == 0));
+	}
+	for (auto& x : s.inst) {
+		const Subcircuit& e = *defs[x.def];
+		size_t Q = e.portCount();
+		for (size_t p = 0; p < Q; p++) {
+			for (size_t q = 0; q < Q; q++) stamp(index(x.nodes[p]), index(x.nodes[q]), e.G[p * Q + q]);
+			inject(index(x.nodes[p]), e.J[p]);
+		}
+		s.grounded = s.grounded || e.grounded || std::count(x.nodes.begin(), x.nodes.end(), 0u);
+	}
+
+	/* Split into the port and internal blocks */
+	std::vector<MatrixEntry> Aii, Api;
+	std::vector<double> Aip(m * P, 0.0);
+	s.G.assign(P * P, 0.0);
+	for (auto& e : A) {
+		if (e.row < P && e.col < P) s.G[e.row * P + e.col] += e.value;
+		else if (e.row < P) Api.push_back(e);
+		else if (e.col < P) Aip[(e.row - P) * P + e.col] += e.value;
+		else Aii.push_back({e.row - P, e.col - P, e.value});
+	}
+
+	/* K = Aii^-1 Aip and c = Aii^-1 bi, a column at a time */
+	s.K.assign(m * P, 0.0);
+	s.c.assign(m, 0.0);
+	if (m) {
+		LUFactor lu(m, Aii);
+		Vector col(0.0, m);
+		for (size_t q = 0; q <= P; q++) {
+			for (size_t i = 0; i < m; i++) col[i] = q < P ? Aip[i * P + q] : b[P + i];
+			Vector x = lu.solve(col);
+			for (size_t i = 0; i < m; i++) {
+				if (!std::isfinite(x[i])) {
+					error = std::string("Subcircuit ") + s.name + " has internal nodes with no path to its ports.";
+					return false;
+				}
+				if (q < P) s.K[i * P + q] = x[i];
+				else s.c[i] = x[i];
+			}
+		}
+	}
+
+	/* G = App - Api K, J = bp - Api c */
+	s.J.assign(b.begin(), b.begin() + P);
+	for (auto& e : Api) {
+		size_t i = e.col - P;
+		for (size_t q = 0; q < P; q++) s.G[e.row * P + q] -= e.value * s.K[i * P + q];
+		s.J[e.row] -= e.value * s.c[i];
+	}
+
+	s.internal.assign(nodeLabels.begin() + P, nodeLabels.end());
+	s.unknowns = m;
+	s.built = true;
+	active[d] = 0;
+	return true;
+}
+
+bool buildMacromodel(std::vector<std::shared_ptr<Subcircuit>>& defs, unsigned int d, std::string& error) {
+	std::vector<char> active(defs.size(), 0);
+	return build(defs, d, active, error);
+}
+
+std::vector<double> Subcircuit::recover(const std::vector<double>& portVoltage) const {
+	const size_t P = portCount();
+	std::vector<double> x(c);
+	for (size_t i = 0; i < unknowns; i++)
+		for (size_t q = 0; q < P; q++) x[i] -= K[i * P + q] * portVoltage[q];
+	return x;
+}